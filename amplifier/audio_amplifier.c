@@ -18,8 +18,11 @@
 #define LOG_TAG "audio_amplifier"
 //#define LOG_NDEBUG 0
 
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <cutils/log.h>
 #include <cutils/str_parms.h>
 
@@ -31,11 +34,21 @@
 
 #define UNUSED __attribute__ ((unused))
 
+/* Longest the init thread can take: clocks on plus tfa_wait_for_init() */
+#define AMP_INIT_TIMEOUT_MS 6000
+
 typedef struct amp_device {
     amplifier_device_t amp_dev;
     tfa_t *tfa;
     tfa_profile_t profile;
     audio_mode_t mode;
+    /* Guards tfa, profile and ready against the init thread */
+    pthread_mutex_t lock;
+    /* Signalled once ready is set */
+    pthread_cond_t ready_cond;
+    pthread_t init_thread;
+    bool init_started;
+    bool ready;
 } amp_device_t;
 
 static amp_device_t *amp_dev = NULL;
@@ -152,24 +165,71 @@ static int select_profile(audio_mode_t mode, uint32_t snd_device)
     return -1;
 }
 
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * The init thread holds the amplifier PCM and toggles the mixer switch
+ * the speaker paths also set, so anything that touches the TFA waits for
+ * it first. Called with dev->lock held; false if init did not finish in
+ * time.
+ */
+static bool wait_ready_locked(amp_device_t *dev)
+{
+    struct timespec deadline;
+
+    if (dev->ready) {
+        return true;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += AMP_INIT_TIMEOUT_MS / 1000;
+    deadline.tv_nsec += (AMP_INIT_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (!dev->ready) {
+        if (pthread_cond_timedwait(&dev->ready_cond, &dev->lock, &deadline) == ETIMEDOUT) {
+            ALOGE("%s: amplifier not initialized after %d ms", __func__, AMP_INIT_TIMEOUT_MS);
+            return dev->ready;
+        }
+    }
+    return true;
+}
+
 static int amp_enable_output_devices(struct amplifier_device *device, uint32_t snd_device, bool enable UNUSED)
 {
     amp_device_t *dev = (amp_device_t *) device;
     int profile = select_profile(dev->mode, snd_device);
+    bool ready;
+
+    // the audio HAL drives the speaker path once this returns, so every
+    // call waits for init, not just the ones that change the profile
+    pthread_mutex_lock(&dev->lock);
+    ready = wait_ready_locked(dev);
 
     if (profile < 0 || profile >= PROFILE_MAX) {
         ALOGE("%s: Invalid profile: %d", __func__, profile);
         goto out;
     }
-    if (profile == amp_dev->profile) {
-        // no need to re-apply current profile
-        goto out;
-    }
 
-    tfa_apply_profile(dev->tfa, profile);
-    amp_dev->profile = profile;
+    if (profile != dev->profile) {
+        // if init is late, it applies the latest profile once it is done
+        if (ready) {
+            tfa_apply_profile(dev->tfa, profile);
+        }
+        dev->profile = profile;
+    }
 
 out:
+    pthread_mutex_unlock(&dev->lock);
     return 0;
 }
 
@@ -177,21 +237,47 @@ static int amp_dev_close(hw_device_t *device)
 {
     amp_device_t *dev = (amp_device_t *) device;
 
+    if (dev->init_started) {
+        pthread_join(dev->init_thread, NULL);
+    }
     tfa_destroy(dev->tfa);
+    pthread_cond_destroy(&dev->ready_cond);
+    pthread_mutex_destroy(&dev->lock);
     free(dev);
 
     return 0;
 }
 
-static void init(void)
+static void *init(void *arg)
 {
+    amp_device_t *dev = (amp_device_t *) arg;
+    int64_t start, clocks_on, done;
     struct pcm *pcm;
+    bool ok = false;
 
     ALOGI("Initializing");
-    tfa_apply_profile(amp_dev->tfa, PROFILE_MUSIC);
-    pcm = tfa_clocks_on(amp_dev->tfa);
-    ALOGI("Init successful: %d", tfa_wait_for_init(amp_dev->tfa));
-    tfa_clocks_off(amp_dev->tfa, pcm);
+    start = now_ms();
+    tfa_apply_profile(dev->tfa, PROFILE_MUSIC);
+    pcm = tfa_clocks_on(dev->tfa);
+    clocks_on = now_ms();
+    if (pcm) {
+        ok = tfa_wait_for_init(dev->tfa);
+        tfa_clocks_off(dev->tfa, pcm);
+    }
+    done = now_ms();
+    ALOGI("Init successful: %d (clocks on %lld ms, wait %lld ms, total %lld ms)", ok,
+            (long long) (clocks_on - start), (long long) (done - clocks_on),
+            (long long) (done - start));
+
+    pthread_mutex_lock(&dev->lock);
+    dev->ready = true;
+    if (dev->profile != PROFILE_MUSIC) {
+        tfa_apply_profile(dev->tfa, dev->profile);
+    }
+    pthread_cond_broadcast(&dev->ready_cond);
+    pthread_mutex_unlock(&dev->lock);
+
+    return NULL;
 }
 
 static int amp_module_open(const hw_module_t *module, const char *name UNUSED,
@@ -199,6 +285,7 @@ static int amp_module_open(const hw_module_t *module, const char *name UNUSED,
 {
     int ret;
     tfa_t *tfa;
+    pthread_condattr_t attr;
 
     if (amp_dev) {
         ALOGE("%s:%d: Unable to open second instance of the amplifier\n", __func__, __LINE__);
@@ -234,8 +321,20 @@ static int amp_module_open(const hw_module_t *module, const char *name UNUSED,
     amp_dev->amp_dev.input_stream_standby = NULL;
 
     amp_dev->tfa = tfa;
-
-    init();
+    amp_dev->profile = PROFILE_MUSIC;
+    pthread_mutex_init(&amp_dev->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&amp_dev->ready_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* Amplifier bring-up polls for up to seconds; don't hold up HAL open */
+    if (pthread_create(&amp_dev->init_thread, NULL, init, amp_dev) == 0) {
+        amp_dev->init_started = true;
+    } else {
+        ALOGE("%s: failed to start init thread, initializing inline", __func__);
+        init(amp_dev);
+    }
 
     *device = (hw_device_t *) amp_dev;
 
@@ -35,13 +35,29 @@
 #include <linux/ioctl.h>
 #include <sound/htc_ioctl.h>
 
+#define SND_CARD        0
+#define AMP_PCM_DEV     47
+#define AMP_MIXER_CTL   "QUAT_MI2S_RX_DL_HL Switch"
+#define MANSTATE_CTL    "NXP MANSTATE"
+#define PROFILE_CTL     "PME Profile"
+
 struct tfaS {
     struct mixer *mixer;
+    /* Looked up once; NULL if the kernel does not expose the control */
+    struct mixer_ctl *clock_ctl;
+    struct mixer_ctl *manstate_ctl;
+    struct mixer_ctl *profile_ctl;
 };
 
-#define SND_CARD        0
-#define AMP_PCM_DEV     47
-#define AMP_MIXER_CTL   "QUAT_MI2S_RX_DL_HL Switch"
+static struct mixer_ctl *get_ctl(struct mixer *mixer, const char *name)
+{
+    struct mixer_ctl *ctl = mixer_get_ctl_by_name(mixer, name);
+
+    if (ctl == NULL) {
+        ALOGE("%s: Could not find %s", __func__, name);
+    }
+    return ctl;
+}
 
 tfa_t *tfa_new(void)
 {
@@ -60,13 +76,16 @@ tfa_t *tfa_new(void)
     }
 
     t->mixer = mixer;
+    t->clock_ctl = get_ctl(mixer, AMP_MIXER_CTL);
+    t->manstate_ctl = get_ctl(mixer, MANSTATE_CTL);
+    t->profile_ctl = get_ctl(mixer, PROFILE_CTL);
 
     return t;
 }
 
 void tfa_destroy(tfa_t *t)
 {
-    mixer_close(0);
+    mixer_close(t->mixer);
     free(t);
 }
 
@@ -83,11 +102,10 @@ static struct pcm_config amp_pcm_config = {
 
 struct pcm *tfa_clocks_on(tfa_t *t)
 {
-    struct mixer_ctl *ctl;
+    struct mixer_ctl *ctl = t->clock_ctl;
     struct pcm *pcm;
     struct pcm_params *pcm_params;
 
-    ctl = mixer_get_ctl_by_name(t->mixer, AMP_MIXER_CTL);
     if (ctl == NULL) {
         ALOGE("%s: Could not find %s", __func__, AMP_MIXER_CTL);
         return NULL;
@@ -125,11 +143,10 @@ struct pcm *tfa_clocks_on(tfa_t *t)
 
 int tfa_clocks_off(tfa_t *t, struct pcm *pcm)
 {
-    struct mixer_ctl *ctl;
+    struct mixer_ctl *ctl = t->clock_ctl;
 
     pcm_close(pcm);
 
-    ctl = mixer_get_ctl_by_name(t->mixer, AMP_MIXER_CTL);
     if (ctl == NULL) {
         ALOGE("%s: Could not find %s", __func__, AMP_MIXER_CTL);
         return -ENODEV;
@@ -143,12 +160,11 @@ int tfa_clocks_off(tfa_t *t, struct pcm *pcm)
 
 bool tfa_wait_for_init(tfa_t *t)
 {
-    struct mixer_ctl *ctl;
+    struct mixer_ctl *ctl = t->manstate_ctl;
     int retries = 0;
 
-    ctl = mixer_get_ctl_by_name(t->mixer, "NXP MANSTATE");
     if (ctl == NULL) {
-        ALOGE("%s: Could not find %s", __func__, "NXP MANSTATE");
+        ALOGE("%s: Could not find %s", __func__, MANSTATE_CTL);
         return false;
     }
 
@@ -165,12 +181,10 @@ bool tfa_wait_for_init(tfa_t *t)
 
 void tfa_apply_profile(tfa_t *t, int profile)
 {
-    struct mixer_ctl *ctl;
-    int retries = 0;
+    struct mixer_ctl *ctl = t->profile_ctl;
 
-    ctl = mixer_get_ctl_by_name(t->mixer, "PME Profile");
     if (ctl == NULL) {
-        ALOGE("%s: Could not find %s", __func__, "PME Profile");
+        ALOGE("%s: Could not find %s", __func__, PROFILE_CTL);
         return;
     }
 
@@ -21,7 +21,9 @@ LOCAL_C_INCLUDES := \
 
 LOCAL_SRC_FILES := \
     CameraParameters.cpp \
-    CameraParameters_EXT.cpp
+    CameraParameters_EXT.cpp \
+    CameraParameterKeys.cpp \
+    CameraSizeListCache.cpp
 
 LOCAL_MODULE_PATH := $(TARGET_OUT_SHARED_LIBRARIES)
 LOCAL_MODULE := libcamera_parameters_ext
@@ -42,3 +44,24 @@ LOCAL_MODULE_TAGS := optional
 LOCAL_MULTILIB := 32
 
 include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_C_INCLUDES := \
+    frameworks/av/include
+
+LOCAL_SRC_FILES := \
+    camera_parameters_bench.cpp
+
+LOCAL_STATIC_LIBRARIES := \
+    libcamera_parameters_ext
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    liblog \
+    libutils
+
+LOCAL_MODULE := camera_parameters_bench
+LOCAL_MODULE_TAGS := optional
+
+include $(BUILD_EXECUTABLE)
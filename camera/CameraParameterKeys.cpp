@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2015 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "CameraParams"
+#include <utils/Log.h>
+
+#include <pthread.h>
+#include <string.h>
+#include <camera/CameraParameters.h>
+#include "CameraParameterKeys.h"
+
+namespace android {
+
+CameraParameterKeys::Entry CameraParameterKeys::sTable[TABLE_SIZE];
+size_t CameraParameterKeys::sCount;
+
+static pthread_once_t sInitOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t sInsertLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *const kKnownKeys[] = {
+    CameraParameters::KEY_PREVIEW_SIZE,
+    CameraParameters::KEY_SUPPORTED_PREVIEW_SIZES,
+    CameraParameters::KEY_PREVIEW_FORMAT,
+    CameraParameters::KEY_SUPPORTED_PREVIEW_FORMATS,
+    CameraParameters::KEY_PREVIEW_FRAME_RATE,
+    CameraParameters::KEY_SUPPORTED_PREVIEW_FRAME_RATES,
+    CameraParameters::KEY_PREVIEW_FPS_RANGE,
+    CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE,
+    CameraParameters::KEY_PICTURE_SIZE,
+    CameraParameters::KEY_SUPPORTED_PICTURE_SIZES,
+    CameraParameters::KEY_PICTURE_FORMAT,
+    CameraParameters::KEY_SUPPORTED_PICTURE_FORMATS,
+    CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH,
+    CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT,
+    CameraParameters::KEY_SUPPORTED_JPEG_THUMBNAIL_SIZES,
+    CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY,
+    CameraParameters::KEY_JPEG_QUALITY,
+    CameraParameters::KEY_ROTATION,
+    CameraParameters::KEY_GPS_LATITUDE,
+    CameraParameters::KEY_GPS_LONGITUDE,
+    CameraParameters::KEY_GPS_ALTITUDE,
+    CameraParameters::KEY_GPS_TIMESTAMP,
+    CameraParameters::KEY_GPS_PROCESSING_METHOD,
+    CameraParameters::KEY_WHITE_BALANCE,
+    CameraParameters::KEY_SUPPORTED_WHITE_BALANCE,
+    CameraParameters::KEY_EFFECT,
+    CameraParameters::KEY_SUPPORTED_EFFECTS,
+    CameraParameters::KEY_ANTIBANDING,
+    CameraParameters::KEY_SUPPORTED_ANTIBANDING,
+    CameraParameters::KEY_SCENE_MODE,
+    CameraParameters::KEY_SUPPORTED_SCENE_MODES,
+    CameraParameters::KEY_FLASH_MODE,
+    CameraParameters::KEY_SUPPORTED_FLASH_MODES,
+    CameraParameters::KEY_FOCUS_MODE,
+    CameraParameters::KEY_SUPPORTED_FOCUS_MODES,
+    CameraParameters::KEY_MAX_NUM_FOCUS_AREAS,
+    CameraParameters::KEY_FOCUS_AREAS,
+    CameraParameters::KEY_FOCAL_LENGTH,
+    CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE,
+    CameraParameters::KEY_VERTICAL_VIEW_ANGLE,
+    CameraParameters::KEY_EXPOSURE_COMPENSATION,
+    CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION,
+    CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION,
+    CameraParameters::KEY_EXPOSURE_COMPENSATION_STEP,
+    CameraParameters::KEY_AUTO_EXPOSURE_LOCK,
+    CameraParameters::KEY_AUTO_EXPOSURE_LOCK_SUPPORTED,
+    CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK,
+    CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK_SUPPORTED,
+    CameraParameters::KEY_MAX_NUM_METERING_AREAS,
+    CameraParameters::KEY_METERING_AREAS,
+    CameraParameters::KEY_ZOOM,
+    CameraParameters::KEY_MAX_ZOOM,
+    CameraParameters::KEY_ZOOM_RATIOS,
+    CameraParameters::KEY_ZOOM_SUPPORTED,
+    CameraParameters::KEY_SMOOTH_ZOOM_SUPPORTED,
+    CameraParameters::KEY_FOCUS_DISTANCES,
+    CameraParameters::KEY_VIDEO_FRAME_FORMAT,
+    CameraParameters::KEY_VIDEO_SIZE,
+    CameraParameters::KEY_SUPPORTED_VIDEO_SIZES,
+    CameraParameters::KEY_PREFERRED_PREVIEW_SIZE_FOR_VIDEO,
+    CameraParameters::KEY_MAX_NUM_DETECTED_FACES_HW,
+    CameraParameters::KEY_MAX_NUM_DETECTED_FACES_SW,
+    CameraParameters::KEY_RECORDING_HINT,
+    CameraParameters::KEY_VIDEO_SNAPSHOT_SUPPORTED,
+    CameraParameters::KEY_VIDEO_STABILIZATION,
+    CameraParameters::KEY_VIDEO_STABILIZATION_SUPPORTED,
+    CameraParameters::KEY_LIGHTFX,
+    CameraParameters::KEY_SMILEINFO_BYFACE_SUPPORTED,
+    CameraParameters_EXT::KEY_FASTVIDEO_FPS60_1080P_SUPPORTED,
+    CameraParameters_EXT::KEY_SLOW_MOTION_SUPPORTED,
+    CameraParameters_EXT::KEY_SLOW_MOTION_MULTIPLE,
+    CameraParameters_EXT::KEY_SLOW_MOTION_RES,
+    CameraParameters_EXT::KEY_FASTVIDEO_FPS60_SUPPORTED,
+    CameraParameters_EXT::KEY_CONTIBURST_TAKE,
+    CameraParameters_EXT::KEY_CONTIBURST_SUPPORTED_MODE,
+    CameraParameters_EXT::KEY_NON_ZSL_MANUAL_MODE,
+    CameraParameters_EXT::KEY_VIDEO_MODE,
+    CameraParameters_EXT::KEY_FORCE_USE_AUDIO_ENABLED,
+    CameraParameters_EXT::KEY_SLOW_MOTION_VERSION,
+    CameraParameters_EXT::KEY_SAVE_MIRROR,
+    CameraParameters_EXT::KEY_SMILEINFO_BYFACE_SUPPORTED,
+    // set and read by name in CameraParameters_EXT.cpp
+    "preview-frame-rate-mode",
+    "brightness-luma-target-set",
+    "touch-index-aec",
+    "touch-index-af",
+    "zsl",
+    "raw-size",
+    "hfr-size-values",
+    "orientation",
+    "hdr-need-1x",
+};
+
+// FNV-1a over key, stopping at len bytes or the terminator. Returns false
+// if the key contains one of the flatten() separators.
+static inline bool hashKey(const char *key, size_t *len, uint32_t *hash)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < *len && key[i] != '\0'; i++) {
+        char c = key[i];
+        if (c == '=' || c == ';')
+            return false;
+        h = (h ^ (unsigned char)c) * 16777619u;
+    }
+
+    *len = i;
+    *hash = h;
+    return true;
+}
+
+void CameraParameterKeys::init()
+{
+    for (size_t i = 0; i < sizeof(kKnownKeys) / sizeof(kKnownKeys[0]); i++) {
+        size_t len = (size_t)-1;
+        uint32_t hash;
+
+        if (hashKey(kKnownKeys[i], &len, &hash))
+            lookup(kKnownKeys[i], len, hash, true);
+    }
+}
+
+const String8 *CameraParameterKeys::insert(const char *key, size_t len, uint32_t hash)
+{
+    const String8 *found = NULL;
+
+    pthread_mutex_lock(&sInsertLock);
+
+    size_t i = hash & (TABLE_SIZE - 1);
+    for (;;) {
+        Entry &e = sTable[i];
+        const String8 *str = e.str;
+        if (str == NULL)
+            break;
+        // Another thread may have added it since the lookup
+        if (e.hash == hash && e.len == len && memcmp(str->string(), key, len) == 0) {
+            found = str;
+            goto out;
+        }
+        i = (i + 1) & (TABLE_SIZE - 1);
+    }
+
+    if (sCount >= MAX_ENTRIES) {
+        ALOGW("Parameter key table is full, not interning \"%.*s\"", (int)len, key);
+        goto out;
+    }
+
+    sTable[i].hash = hash;
+    sTable[i].len = len;
+    found = new Key(key, len);
+    __atomic_store_n(&sTable[i].str, found, __ATOMIC_RELEASE);
+    __atomic_store_n(&sCount, sCount + 1, __ATOMIC_RELEASE);
+
+out:
+    pthread_mutex_unlock(&sInsertLock);
+    return found;
+}
+
+const String8 *CameraParameterKeys::lookup(const char *key, size_t len, uint32_t hash,
+        bool add)
+{
+    size_t i = hash & (TABLE_SIZE - 1);
+    for (;;) {
+        const Entry &e = sTable[i];
+        const String8 *str = __atomic_load_n(&e.str, __ATOMIC_ACQUIRE);
+        if (str == NULL)
+            return add ? insert(key, len, hash) : NULL;
+        if (e.hash == hash && e.len == len && memcmp(str->string(), key, len) == 0)
+            return str;
+        i = (i + 1) & (TABLE_SIZE - 1);
+    }
+}
+
+const String8 *CameraParameterKeys::intern(const char *key, size_t len, bool *valid)
+{
+    uint32_t hash;
+
+    pthread_once(&sInitOnce, init);
+
+    *valid = hashKey(key, &len, &hash);
+    if (!*valid)
+        return NULL;
+
+    return lookup(key, len, hash, true);
+}
+
+const String8 *CameraParameterKeys::find(const char *key)
+{
+    size_t len = (size_t)-1;
+    uint32_t hash;
+
+    pthread_once(&sInitOnce, init);
+
+    if (!hashKey(key, &len, &hash))
+        return NULL;
+
+    return lookup(key, len, hash, false);
+}
+
+ssize_t CameraParameterKeys::indexOfKey(const KeyedVector<String8, String8> &map,
+        const String8 *key)
+{
+    const Key *k = static_cast<const Key *>(key);
+    int32_t hint = __atomic_load_n(&k->hint, __ATOMIC_RELAXED);
+
+    // Keys stored from an interned key share its buffer
+    if (hint >= 0 && (size_t)hint < map.size() &&
+            map.keyAt(hint).string() == key->string())
+        return hint;
+
+    ssize_t idx = map.indexOfKey(*key);
+    if (idx >= 0)
+        __atomic_store_n(&k->hint, (int32_t)idx, __ATOMIC_RELAXED);
+    return idx;
+}
+
+}; // namespace android
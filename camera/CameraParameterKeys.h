@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2015 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_CAMERA_PARAMETER_KEYS_H
+#define ANDROID_HARDWARE_CAMERA_PARAMETER_KEYS_H
+
+#include <stdint.h>
+#include <utils/KeyedVector.h>
+#include <utils/String8.h>
+
+namespace android {
+
+/*
+ * Process-wide table of parameter names. Every key is kept as one String8
+ * with its hash precomputed, so CameraParameters can look keys up and
+ * store them without building a temporary String8 per call; copies of an
+ * interned key share its buffer.
+ *
+ * The known CameraParameters and CameraParameters_EXT keys are added on
+ * first use, other keys as they are set. Entries are never removed, and
+ * lookups do not take a lock.
+ *
+ * Each key also remembers the index it was last found at in a parameter
+ * map. Parameter sets in a process mostly hold the same keys, so checking
+ * that slot first usually saves the binary search; the check compares
+ * buffers, not strings, so a stale hint only costs the search.
+ */
+class CameraParameterKeys
+{
+public:
+    /*
+     * Returns the interned copy of key, or of its first len bytes, adding it
+     * if it is new. Returns NULL and clears *valid if the key contains '='
+     * or ';', and returns NULL with *valid set if the table is full.
+     */
+    static const String8 *intern(const char *key, size_t len, bool *valid);
+    static const String8 *intern(const char *key, bool *valid) {
+        return intern(key, (size_t)-1, valid);
+    }
+
+    /* Returns the interned copy of key, or NULL if it has not been seen. */
+    static const String8 *find(const char *key);
+
+    /*
+     * True once keys stop being interned. Until then a key find() does not
+     * know cannot be stored in any CameraParameters.
+     */
+    static bool full() {
+        return __atomic_load_n(&sCount, __ATOMIC_ACQUIRE) >= MAX_ENTRIES;
+    }
+
+    /* indexOfKey() for an interned key, trying its last index first. */
+    static ssize_t indexOfKey(const KeyedVector<String8, String8> &map, const String8 *key);
+
+    /* Records where an interned key was just added to a map. */
+    static void setIndexHint(const String8 *key, ssize_t index) {
+        __atomic_store_n(&static_cast<const Key *>(key)->hint, (int32_t)index,
+                __ATOMIC_RELAXED);
+    }
+
+private:
+    struct Key : public String8 {
+        Key(const char *key, size_t len) : String8(key, len), hint(-1) {}
+        mutable int32_t hint;
+    };
+
+    struct Entry {
+        const String8 *str;     // published last; NULL while the slot is free
+        uint32_t hash;
+        uint32_t len;
+    };
+
+    static void init();
+    static const String8 *lookup(const char *key, size_t len, uint32_t hash, bool add);
+    static const String8 *insert(const char *key, size_t len, uint32_t hash);
+
+    enum {
+        TABLE_SIZE = 1024,      // power of two
+        MAX_ENTRIES = 768,
+    };
+
+    static Entry sTable[TABLE_SIZE];
+    static size_t sCount;
+};
+
+}; // namespace android
+
+#endif
@@ -18,11 +18,15 @@
 #define LOG_TAG "CameraParams"
 #include <utils/Log.h>
 
+#include <pthread.h>
+#include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
 #include <camera/CameraParameters.h>
 #include <camera/CameraParametersExtra.h>
 #include <system/graphics.h>
+#include "CameraParameterKeys.h"
+#include "CameraSizeListCache.h"
 
 namespace android {
 // Parameter keys to communicate between camera application and driver.
@@ -180,6 +184,62 @@ const char CameraParameters::LIGHTFX_HDR[] = "high-dynamic-range";
 const char CameraParameters::SCENE_MODE_TEXT[] = "text";
 const char CameraParameters::KEY_SMILEINFO_BYFACE_SUPPORTED[] = "smileinfo-byface-supported";
 
+// Stores value under key, reusing the interned key and leaving the
+// existing value (and pointers handed out by get()) alone if it is equal.
+static void storeValue(KeyedVector<String8, String8> &map, const String8 *key,
+                       const char *rawKey, const char *value)
+{
+    if (key == NULL) {
+        map.replaceValueFor(String8(rawKey), String8(value));
+        return;
+    }
+
+    ssize_t idx = CameraParameterKeys::indexOfKey(map, key);
+    if (idx >= 0) {
+        // Editing would unshare storage a cached flatten() holds
+        if (strcmp(map.valueAt(idx).string(), value) != 0)
+            map.editValueAt(idx).setTo(value);
+        return;
+    }
+
+    CameraParameterKeys::setIndexHint(key, map.add(*key, String8(value)));
+}
+
+// Recent flatten() results. The class layout is fixed by the camera HAL,
+// so they live in a small direct-mapped table keyed by object instead.
+// Each entry keeps a copy of the map it was built from: KeyedVector is
+// copy-on-write, so the copy shares the map's storage until the map is
+// next edited, and a map still sharing that storage is unchanged.
+#define FLATTEN_CACHE_SLOTS 8
+
+struct FlattenCache {
+    const CameraParameters *owner;
+    KeyedVector<String8, String8> map;
+    String8 flattened;
+};
+
+static pthread_mutex_t sFlattenLock = PTHREAD_MUTEX_INITIALIZER;
+static FlattenCache *sFlattenCache[FLATTEN_CACHE_SLOTS];
+
+static inline size_t flattenSlot(const CameraParameters *p)
+{
+    return ((uintptr_t)p >> 4) % FLATTEN_CACHE_SLOTS;
+}
+
+static inline bool sameStorage(const KeyedVector<String8, String8> &a,
+                               const KeyedVector<String8, String8> &b)
+{
+    return a.size() == b.size() && a.size() > 0 && &a.keyAt(0) == &b.keyAt(0);
+}
+
+static inline int compareKeys(const String8 &a, const String8 &b)
+{
+    // Interned keys share a buffer
+    if (a.string() == b.string())
+        return 0;
+    return strcmp(a.string(), b.string());
+}
+
 CameraParameters::CameraParameters()
     : CameraParameters_EXT(this), mMap()
 {
@@ -187,57 +247,206 @@ CameraParameters::CameraParameters()
 
 CameraParameters::~CameraParameters()
 {
+    size_t slot = flattenSlot(this);
+
+    pthread_mutex_lock(&sFlattenLock);
+    FlattenCache *c = sFlattenCache[slot];
+    if (c != NULL && c->owner == this) {
+        c->owner = NULL;
+        c->map.clear();
+        c->flattened = String8();
+    }
+    pthread_mutex_unlock(&sFlattenLock);
 }
 
 String8 CameraParameters::flatten() const
 {
-    String8 flattened("");
     size_t size = mMap.size();
 
-    for (size_t i = 0; i < size; i++) {
-        String8 k, v;
-        k = mMap.keyAt(i);
-        v = mMap.valueAt(i);
+    if (size == 0)
+        return String8("");
+
+    size_t slot = flattenSlot(this);
+    FlattenCache *c;
+
+    pthread_mutex_lock(&sFlattenLock);
+    c = sFlattenCache[slot];
+    if (c != NULL && c->owner == this && sameStorage(c->map, mMap)) {
+        String8 flattened(c->flattened);
+        pthread_mutex_unlock(&sFlattenLock);
+        return flattened;
+    }
+    pthread_mutex_unlock(&sFlattenLock);
+
+    // Size the result first so it is built in one allocation
+    size_t len = size - 1;
+    for (size_t i = 0; i < size; i++)
+        len += mMap.keyAt(i).length() + 1 + mMap.valueAt(i).length();
+
+    String8 flattened;
+    char *p = flattened.lockBuffer(len);
+    if (p == NULL)
+        return String8("");
 
-        flattened += k;
-        flattened += "=";
-        flattened += v;
+    for (size_t i = 0; i < size; i++) {
+        const String8 &k = mMap.keyAt(i);
+        const String8 &v = mMap.valueAt(i);
+
+        memcpy(p, k.string(), k.length());
+        p += k.length();
+        *p++ = '=';
+        memcpy(p, v.string(), v.length());
+        p += v.length();
         if (i != size-1)
-            flattened += ";";
+            *p++ = ';';
+    }
+    flattened.unlockBuffer(len);
+
+    pthread_mutex_lock(&sFlattenLock);
+    c = sFlattenCache[slot];
+    if (c == NULL)
+        c = sFlattenCache[slot] = new FlattenCache;
+    if (c != NULL) {
+        c->owner = this;
+        c->map = mMap;
+        c->flattened = flattened;
     }
+    pthread_mutex_unlock(&sFlattenLock);
 
     return flattened;
 }
 
 void CameraParameters::unflatten(const String8 &params)
 {
-    const char *a = params.string();
+    unflatten(params, NULL);
+}
+
+// Splits the next "key=value" item off *a, advancing *a past it.
+// Returns false once there are no more items.
+static bool nextItem(const char **a, const char **key, size_t *keyLen,
+                     const char **value, size_t *valueLen)
+{
     const char *b;
 
-    mMap.clear();
+    if (*a == NULL)
+        return false;
+
+    // Find the bounds of the key name.
+    b = strchr(*a, '=');
+    if (b == 0)
+        return false;
+    *key = *a;
+    *keyLen = (size_t)(b - *a);
+
+    // Find the value.
+    *value = b+1;
+    b = strchr(*value, ';');
+    if (b == 0) {
+        // If there's no semicolon, this is the last item.
+        *valueLen = strlen(*value);
+        *a = NULL;
+    } else {
+        *valueLen = (size_t)(b - *value);
+        *a = b+1;
+    }
+    return true;
+}
+
+static inline bool equals(const String8 &s, const char *str, size_t len)
+{
+    return s.length() == len && memcmp(s.string(), str, len) == 0;
+}
 
-    for (;;) {
-        // Find the bounds of the key name.
-        b = strchr(a, '=');
-        if (b == 0)
-            break;
+void CameraParameters::unflatten(const String8 &params, Vector<String8> *changedKeys)
+{
+    const char *a = params.string();
+    const char *key, *value;
+    size_t keyLen, valueLen;
 
-        // Create the key string.
-        String8 k(a, (size_t)(b-a));
+    if (changedKeys != NULL)
+        changedKeys->clear();
 
-        // Find the value.
-        a = b+1;
-        b = strchr(a, ';');
-        if (b == 0) {
-            // If there's no semicolon, this is the last item.
-            String8 v(a);
-            mMap.add(k, v);
+    // params usually comes from flatten() of a map with the same keys, so
+    // first match it in order against mMap without building anything.
+    size_t i = 0, size = mMap.size();
+    bool inOrder = true;
+
+    while (nextItem(&a, &key, &keyLen, &value, &valueLen)) {
+        if (i == size || !equals(mMap.keyAt(i), key, keyLen)) {
+            inOrder = false;
             break;
         }
+        if (!equals(mMap.valueAt(i), value, valueLen)) {
+            mMap.editValueAt(i).setTo(value, valueLen);
+            if (changedKeys != NULL)
+                changedKeys->push(mMap.keyAt(i));
+        }
+        i++;
+    }
+
+    if (inOrder && i == size)
+        return;
+
+    // Otherwise parse it all and merge. Values updated above already
+    // match, so they are not reported twice.
+    KeyedVector<String8, String8> next;
+
+    a = params.string();
+    while (nextItem(&a, &key, &keyLen, &value, &valueLen)) {
+        // Create the key string, sharing the interned copy if there is one.
+        bool valid;
+        const String8 *ik = CameraParameterKeys::intern(key, keyLen, &valid);
+        String8 k = ik ? *ik : String8(key, keyLen);
+
+        next.add(k, String8(value, valueLen));
+    }
+
+    // Both maps are sorted; walk them together and only edit mMap where
+    // they differ, so unchanged values, the pointers get() returned for
+    // them and a cached flatten() all survive.
+    Vector<String8> removed;
+    Vector<size_t> added;
+    size_t j = 0;
+    size_t oldSize = mMap.size(), newSize = next.size();
+
+    i = 0;
+
+    while (i < oldSize || j < newSize) {
+        int cmp;
+        if (i == oldSize)
+            cmp = 1;
+        else if (j == newSize)
+            cmp = -1;
+        else
+            cmp = compareKeys(mMap.keyAt(i), next.keyAt(j));
+
+        if (cmp < 0) {
+            removed.push(mMap.keyAt(i++));
+        } else if (cmp > 0) {
+            added.push(j++);
+        } else {
+            const String8 &ov = mMap.valueAt(i);
+            const String8 &nv = next.valueAt(j);
+            if (ov.length() != nv.length() || strcmp(ov.string(), nv.string()) != 0) {
+                if (changedKeys != NULL)
+                    changedKeys->push(mMap.keyAt(i));
+                mMap.editValueAt(i) = nv;
+            }
+            i++;
+            j++;
+        }
+    }
+
+    for (size_t n = 0; n < removed.size(); n++) {
+        mMap.removeItem(removed[n]);
+        if (changedKeys != NULL)
+            changedKeys->push(removed[n]);
+    }
 
-        String8 v(a, (size_t)(b-a));
-        mMap.add(k, v);
-        a = b+1;
+    for (size_t n = 0; n < added.size(); n++) {
+        mMap.add(next.keyAt(added[n]), next.valueAt(added[n]));
+        if (changedKeys != NULL)
+            changedKeys->push(next.keyAt(added[n]));
     }
 }
 
@@ -247,13 +456,15 @@ void CameraParameters::set(const char *key, const char *value)
     if (key == NULL || value == NULL)
         return;
 
-    // XXX i think i can do this with strspn()
-    if (strchr(key, '=') || strchr(key, ';')) {
+    // Checked while hashing the key
+    bool valid;
+    const String8 *k = CameraParameterKeys::intern(key, &valid);
+    if (!valid) {
         //XXX ALOGE("Key \"%s\"contains invalid character (= or ;)", key);
         return;
     }
 
-    if (strchr(value, '=') || strchr(value, ';')) {
+    if (value[strcspn(value, "=;")] != '\0') {
         //XXX ALOGE("Value \"%s\"contains invalid character (= or ;)", value);
         return;
     }
@@ -262,11 +473,11 @@ void CameraParameters::set(const char *key, const char *value)
     // The android SDK only wants one frame, so disable this unless the app
     // explicitly asks for it
     if (!get("hdr-need-1x")) {
-        mMap.replaceValueFor(String8("hdr-need-1x"), String8("false"));
+        storeValue(mMap, CameraParameterKeys::find("hdr-need-1x"), "hdr-need-1x", "false");
     }
 #endif
 
-    mMap.replaceValueFor(String8(key), String8(value));
+    storeValue(mMap, k, key, value);
 }
 
 void CameraParameters::set(const char *key, int value)
@@ -285,7 +496,18 @@ void CameraParameters::setFloat(const char *key, float value)
 
 const char *CameraParameters::get(const char *key) const
 {
-    String8 v = mMap.valueFor(String8(key));
+    // Keys not in the table can only have been stored once it was full
+    const String8 *k = CameraParameterKeys::find(key);
+    if (k == NULL && !CameraParameterKeys::full())
+        return 0;
+
+    ssize_t idx = k ? CameraParameterKeys::indexOfKey(mMap, k)
+                    : mMap.indexOfKey(String8(key));
+    if (idx < 0)
+        return 0;
+
+    // Points into the stored value, not a copy
+    const String8 &v = mMap.valueAt(idx);
     if (v.length() == 0)
         return 0;
     return v.string();
@@ -308,7 +530,11 @@ float CameraParameters::getFloat(const char *key) const
 
 void CameraParameters::remove(const char *key)
 {
-    mMap.removeItem(String8(key));
+    const String8 *k = CameraParameterKeys::find(key);
+    if (k)
+        mMap.removeItem(*k);
+    else if (CameraParameterKeys::full())
+        mMap.removeItem(String8(key));
 }
 
 // Parse string like "640x480" or "10000,20000"
@@ -389,7 +615,7 @@ void CameraParameters::getPreferredPreviewSizeForVideo(int *width, int *height)
 void CameraParameters::getSupportedPreviewSizes(Vector<Size> &sizes) const
 {
     const char *previewSizesStr = get(KEY_SUPPORTED_PREVIEW_SIZES);
-    parseSizesList(previewSizesStr, sizes);
+    CameraSizeListCache::get(previewSizesStr, sizes, parseSizesList);
 }
 
 void CameraParameters::setVideoSize(int width, int height)
@@ -410,7 +636,7 @@ void CameraParameters::getVideoSize(int *width, int *height) const
 void CameraParameters::getSupportedVideoSizes(Vector<Size> &sizes) const
 {
     const char *videoSizesStr = get(KEY_SUPPORTED_VIDEO_SIZES);
-    parseSizesList(videoSizesStr, sizes);
+    CameraSizeListCache::get(videoSizesStr, sizes, parseSizesList);
 }
 
 void CameraParameters::setPreviewFrameRate(int fps)
@@ -460,7 +686,7 @@ void CameraParameters::getPictureSize(int *width, int *height) const
 void CameraParameters::getSupportedPictureSizes(Vector<Size> &sizes) const
 {
     const char *pictureSizesStr = get(KEY_SUPPORTED_PICTURE_SIZES);
-    parseSizesList(pictureSizesStr, sizes);
+    CameraSizeListCache::get(pictureSizesStr, sizes, parseSizesList);
 }
 
 void CameraParameters::setPictureFormat(const char *format)
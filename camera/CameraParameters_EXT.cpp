@@ -22,6 +22,8 @@
 #include <camera/CameraParameters.h>
 #include <camera/CameraParameters_EXT.h>
 
+#include "CameraSizeListCache.h"
+
 namespace android {
 
 const char CameraParameters_EXT::SCENE_MODE_AUTOHDR[] = "autohdr";
@@ -257,7 +259,7 @@ void CameraParameters_EXT::getMeteringAreaCenter(int *x, int *y) const
 void CameraParameters_EXT::getSupportedHfrSizes(Vector<Size> &sizes) const
 {
     const char *hfrSizesStr = mParams->get("hfr-size-values");
-    parseSizesList(hfrSizesStr, sizes);
+    CameraSizeListCache::get(hfrSizesStr, sizes, parseSizesList);
 }
 
 void CameraParameters_EXT::setPreviewFpsRange(int min, int max)
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2015 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <utils/String8.h>
+#include "CameraSizeListCache.h"
+
+namespace android {
+
+// Enough for every size list of both cameras
+#define SIZE_LIST_CACHE_SLOTS 16
+
+struct SizeList {
+    String8 text;
+    Vector<Size> sizes;
+};
+
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static SizeList *sLists[SIZE_LIST_CACHE_SLOTS];
+static size_t sNextSlot;
+
+static void appendSizes(Vector<Size> &sizes, const Vector<Size> &parsed)
+{
+    if (sizes.isEmpty())
+        sizes = parsed;
+    else
+        sizes.appendVector(parsed);
+}
+
+void CameraSizeListCache::get(const char *sizesStr, Vector<Size> &sizes, Parser parse)
+{
+    if (sizesStr == 0)
+        return;
+
+    size_t len = strlen(sizesStr);
+
+    pthread_mutex_lock(&sLock);
+    for (size_t i = 0; i < SIZE_LIST_CACHE_SLOTS; i++) {
+        SizeList *l = sLists[i];
+        if (l != NULL && l->text.length() == len &&
+                memcmp(l->text.string(), sizesStr, len) == 0) {
+            Vector<Size> cached(l->sizes);
+            pthread_mutex_unlock(&sLock);
+            appendSizes(sizes, cached);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&sLock);
+
+    Vector<Size> parsed;
+    parse(sizesStr, parsed);
+
+    // Replace the oldest entry
+    pthread_mutex_lock(&sLock);
+    size_t slot = sNextSlot++ % SIZE_LIST_CACHE_SLOTS;
+    if (sLists[slot] == NULL)
+        sLists[slot] = new SizeList;
+    if (sLists[slot] != NULL) {
+        sLists[slot]->text.setTo(sizesStr, len);
+        sLists[slot]->sizes = parsed;
+    }
+    pthread_mutex_unlock(&sLock);
+
+    appendSizes(sizes, parsed);
+}
+
+}; // namespace android
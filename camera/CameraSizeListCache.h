@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2015 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_CAMERA_SIZE_LIST_CACHE_H
+#define ANDROID_HARDWARE_CAMERA_SIZE_LIST_CACHE_H
+
+#include <utils/Vector.h>
+#include <camera/CameraParameters.h>
+
+namespace android {
+
+/*
+ * Recently parsed "WxH,WxH,..." lists, shared by every CameraParameters.
+ * Entries are looked up by the list text itself, so a set() that changes
+ * a list simply stops matching its old entry and nothing has to be
+ * invalidated. The cached Vector<Size> is handed out as a copy-on-write
+ * copy.
+ */
+class CameraSizeListCache
+{
+public:
+    typedef void (*Parser)(const char *sizesStr, Vector<Size> &sizes);
+
+    /*
+     * Appends the sizes listed in sizesStr to sizes, calling parse only if
+     * the same list was not parsed recently. Does nothing for NULL.
+     */
+    static void get(const char *sizesStr, Vector<Size> &sizes, Parser parse);
+};
+
+}; // namespace android
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Microbenchmark for the CameraParameters calls the camera service makes
+ * around camera open and mode switches. Builds a parameter set shaped like
+ * the HAL's (about 150 keys, the real size lists) and reports the mean
+ * time per call.
+ *
+ * usage: camera_parameters_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <camera/CameraParameters.h>
+
+using namespace android;
+
+static const char kPreviewSizes[] =
+    "3840x2160,2560x1440,1920x1080,1440x1080,1280x960,1280x720,1088x1088,"
+    "1080x1080,960x720,800x600,800x480,768x432,720x720,720x480,640x480,"
+    "576x432,480x360,480x320,384x288,352x288,320x240,240x160,176x144,144x176";
+static const char kPictureSizes[] =
+    "5376x3024,4032x3024,4000x3000,4000x2250,3264x2448,3200x2400,3000x3000,"
+    "2592x1944,2592x1458,2048x1536,1920x1080,1600x1200,1280x960,1280x768,"
+    "1280x720,1024x768,800x600,800x480,720x480,640x480,352x288,320x240";
+static const char kVideoSizes[] =
+    "3840x2160,2560x1440,1920x1080,1280x720,864x480,800x480,720x480,640x480,"
+    "480x320,352x288,320x240,176x144";
+static const char kHfrSizes[] = "1920x1080,1280x720,800x480,720x480";
+
+static double nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void populate(CameraParameters &p)
+{
+    char key[48], value[16];
+
+    p.set(CameraParameters::KEY_SUPPORTED_PREVIEW_SIZES, kPreviewSizes);
+    p.set(CameraParameters::KEY_SUPPORTED_PICTURE_SIZES, kPictureSizes);
+    p.set(CameraParameters::KEY_SUPPORTED_VIDEO_SIZES, kVideoSizes);
+    p.set("hfr-size-values", kHfrSizes);
+    p.setPreviewSize(1920, 1080);
+    p.setPictureSize(4032, 3024);
+    p.setVideoSize(1920, 1080);
+    p.set(CameraParameters::KEY_PREFERRED_PREVIEW_SIZE_FOR_VIDEO, "1920x1080");
+    p.set(CameraParameters::KEY_PREVIEW_FPS_RANGE, "7500,30000");
+    p.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE,
+          "(7500,30000),(30000,30000),(7500,60000)");
+    p.setPreviewFormat(CameraParameters::PIXEL_FORMAT_YUV420SP);
+    p.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FORMATS, "yuv420sp,yuv420p,nv12-venus");
+    p.set(CameraParameters::KEY_FOCUS_MODE, CameraParameters::FOCUS_MODE_CONTINUOUS_PICTURE);
+    p.set(CameraParameters::KEY_ZOOM, 0);
+
+    // Vendor keys make up most of a real set
+    for (int i = 0; i < 130; i++) {
+        snprintf(key, sizeof(key), "qc-vendor-param-%d", i);
+        snprintf(value, sizeof(value), "%d", i * 7);
+        p.set(key, value);
+    }
+}
+
+#define BENCH(name, iters, stmt) do {                                     \
+        double start = nowNs();                                          \
+        for (int n_ = 0; n_ < (iters); n_++) {                           \
+            stmt;                                                        \
+        }                                                                \
+        printf("%-32s %10.0f ns\n", name, (nowNs() - start) / (iters));  \
+    } while (0)
+
+int main(int argc, char **argv)
+{
+    int iters = argc > 1 ? atoi(argv[1]) : 10000;
+    CameraParameters p;
+    Vector<Size> sizes;
+    Vector<String8> changed;
+    int w, h;
+    volatile int sink = 0;
+
+    if (iters <= 0) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    populate(p);
+    String8 flat = p.flatten();
+    size_t keys = 1;
+    for (const char *c = flat.string(); *c; c++)
+        keys += *c == ';';
+    printf("%zu keys, %zu bytes flattened\n", keys, flat.length());
+
+    BENCH("get", iters, sink += p.get(CameraParameters::KEY_FOCUS_MODE) != NULL);
+    BENCH("get (absent)", iters, sink += p.get("not-a-parameter") != NULL);
+    BENCH("getInt", iters, sink += p.getInt(CameraParameters::KEY_ZOOM));
+    BENCH("set (same value)", iters, p.set(CameraParameters::KEY_ZOOM, 0));
+    BENCH("set (new value)", iters, p.set(CameraParameters::KEY_ZOOM, n_ & 1));
+    BENCH("getPreviewSize", iters, p.getPreviewSize(&w, &h));
+    BENCH("getPreviewFpsRange", iters, p.getPreviewFpsRange(&w, &h));
+    BENCH("getSupportedPreviewSizes", iters,
+          sizes.clear(); p.getSupportedPreviewSizes(sizes));
+    BENCH("getSupportedPictureSizes", iters,
+          sizes.clear(); p.getSupportedPictureSizes(sizes));
+    BENCH("getSupportedVideoSizes", iters,
+          sizes.clear(); p.getSupportedVideoSizes(sizes));
+    BENCH("getSupportedHfrSizes", iters,
+          sizes.clear(); p.getSupportedHfrSizes(sizes));
+    BENCH("flatten (unchanged)", iters, flat = p.flatten());
+    BENCH("set + flatten", iters, p.set(CameraParameters::KEY_ZOOM, n_ & 1); flat = p.flatten());
+    BENCH("unflatten (same string)", iters, p.unflatten(flat));
+    BENCH("unflatten + diff (same)", iters, p.unflatten(flat, &changed));
+    BENCH("CameraParameters(String8)", iters, CameraParameters q(flat); sink += q.isEmpty());
+
+    return sink == -1;
+}
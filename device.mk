@@ -251,6 +251,9 @@ PRODUCT_PACKAGES += \
     power.msm8996 \
     thermal.msm8996
 
+PRODUCT_COPY_FILES += \
+    $(LOCAL_PATH)/configs/perf_lock.conf:system/vendor/etc/perf_lock.conf
+
 # Properties
 PRODUCT_PACKAGES += \
     operator-properties
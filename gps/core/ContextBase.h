@@ -36,6 +36,9 @@
 #include <LBSProxyBase.h>
 
 #define MAX_XTRA_SERVER_URL_LENGTH 256
+/* the conf parser copies up to LOC_MAX_PARAM_STRING + 1 bytes */
+#define MAX_NMEA_SENTENCE_ID_LENGTH 81
+#define MAX_SHM_RING_PATH_LENGTH 81
 
 /* GPS.conf support */
 /* NOTE: the implementaiton of the parser casts number
@@ -63,6 +66,10 @@ typedef struct loc_gps_cfg_s
     uint32_t       LPPE_CP_TECHNOLOGY;
     uint32_t       LPPE_UP_TECHNOLOGY;
     uint32_t       EXTERNAL_DR_ENABLED;
+    uint32_t       LATENCY_PROFILING;
+    uint32_t       NMEA_BATCH;
+    char           NMEA_BATCH_FLUSH[MAX_NMEA_SENTENCE_ID_LENGTH];
+    char           GNSS_RAW_SHM_RING[MAX_SHM_RING_PATH_LENGTH];
 } loc_gps_cfg_s_type;
 
 /* NOTE: the implementaiton of the parser casts number
@@ -30,15 +30,119 @@
 #define LOG_TAG "LocSvc_LocApiBase"
 
 #include <dlfcn.h>
+#include <pthread.h>
+#include <string.h>
 #include <LocApiBase.h>
 #include <LocAdapterBase.h>
 #include <platform_lib_log_util.h>
 #include <LocDualContext.h>
+#include <LocLatency.h>
+#include <LocShmRing.h>
 
 namespace loc_core {
 
 #define TO_ALL_LOCADAPTERS(call) TO_ALL_ADAPTERS(mLocAdapters, (call))
 #define TO_1ST_HANDLING_LOCADAPTERS(call) TO_1ST_HANDLING_ADAPTER(mLocAdapters, (call))
+#define TO_EVENT_LOCADAPTERS(event, call)                               \
+    {                                                                   \
+        LocApiBaseExt* ext = findExt(this);                             \
+        LocAdapterBase** adapters =                                     \
+            (NULL != ext) ? ext->eventAdapters[event] : mLocAdapters;   \
+        TO_ALL_ADAPTERS(adapters, (call))                               \
+    }
+
+// LocApiBase state added after the prebuilt LocApi subclasses were
+// compiled against its layout, so it lives here, keyed by the object.
+struct LocApiBaseExt {
+    const LocApiBase* owner;
+    // per event subscriber lists, packed and NULL terminated like
+    // mLocAdapters, rebuilt whenever an adapter or its mask changes
+    LocAdapterBase* eventAdapters[LOC_API_FANOUT_MAX][MAX_ADAPTERS];
+    // adapters that opted in to mask based filtering, packed
+    LocAdapterBase* maskedAdapters[MAX_ADAPTERS];
+    // optional shared memory copy of the raw measurement reports
+    LocShmRing* shmRing;
+};
+
+#define MAX_LOC_APIS 8
+static LocApiBaseExt sLocApiExts[MAX_LOC_APIS];
+static pthread_mutex_t sLocApiExtLock = PTHREAD_MUTEX_INITIALIZER;
+
+// slots are claimed once per object and never move, so lookups from
+// the report path need no lock
+static LocApiBaseExt* findExt(const LocApiBase* owner)
+{
+    for (int i = 0; i < MAX_LOC_APIS; i++) {
+        if (sLocApiExts[i].owner == owner) {
+            return &sLocApiExts[i];
+        }
+    }
+    return NULL;
+}
+
+static LocApiBaseExt* claimExt(const LocApiBase* owner)
+{
+    pthread_mutex_lock(&sLocApiExtLock);
+    // a new object at a destroyed one's address takes over its slot
+    LocApiBaseExt* ext = findExt(owner);
+    if (NULL == ext) {
+        ext = findExt(NULL);
+    }
+    if (NULL != ext) {
+        // the destructor is inline in the prebuilt LocApis and can't
+        // free the ring, so a slot's ring goes when the slot is reused
+        delete ext->shmRing;
+        memset(ext, 0, sizeof(*ext));
+        ext->owner = owner;
+    } else {
+        LOC_LOGE("%s: no free slot, reports go to all adapters", __func__);
+    }
+    pthread_mutex_unlock(&sLocApiExtLock);
+    return ext;
+}
+
+static bool isMasked(const LocApiBaseExt* ext, const LocAdapterBase* adapter)
+{
+    for (int i = 0; i < MAX_ADAPTERS && NULL != ext->maskedAdapters[i]; i++) {
+        if (ext->maskedAdapters[i] == adapter) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void removeMasked(LocApiBaseExt* ext, LocAdapterBase* adapter)
+{
+    if (NULL == ext) {
+        return;
+    }
+    for (int i = 0; i < MAX_ADAPTERS && NULL != ext->maskedAdapters[i]; i++) {
+        if (ext->maskedAdapters[i] == adapter) {
+            // keep the list packed
+            int last = i;
+            while (last + 1 < MAX_ADAPTERS && NULL != ext->maskedAdapters[last + 1]) {
+                last++;
+            }
+            ext->maskedAdapters[i] = ext->maskedAdapters[last];
+            ext->maskedAdapters[last] = NULL;
+            break;
+        }
+    }
+}
+
+static void rebuildEventAdapters(LocApiBaseExt* ext, LocAdapterBase* const* locAdapters);
+
+// event mask bits that subscribe an adapter to each fan-out list,
+// indexed by loc_api_fanout_event
+static const LOC_API_ADAPTER_EVENT_MASK_T sFanoutEventMasks[LOC_API_FANOUT_MAX] = {
+    LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT,
+    LOC_API_ADAPTER_BIT_SATELLITE_REPORT,
+    LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT |
+    LOC_API_ADAPTER_BIT_NMEA_POSITION_REPORT,
+    LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT_REPORT,
+    LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT,
+    LOC_API_ADAPTER_BIT_GNSS_SV_POLYNOMIAL_REPORT
+};
 
 int hexcode(char *hexstring, int string_size,
             const char *data, int data_size)
@@ -132,7 +236,12 @@ LocApiBase::LocApiBase(const MsgTask* msgTask,
     mMask(0), mSupportedMsg(0), mContext(context)
 {
     memset(mLocAdapters, 0, sizeof(mLocAdapters));
+    LocApiBaseExt* ext = claimExt(this);
     memset(mFeaturesSupported, 0, sizeof(mFeaturesSupported));
+
+    if (NULL != ext && '\0' != ContextBase::mGps_conf.GNSS_RAW_SHM_RING[0]) {
+        ext->shmRing = LocShmRing::create(ContextBase::mGps_conf.GNSS_RAW_SHM_RING);
+    }
 }
 
 LOC_API_ADAPTER_EVENT_MASK_T LocApiBase::getEvtMask()
@@ -162,6 +271,7 @@ void LocApiBase::addAdapter(LocAdapterBase* adapter)
     for (int i = 0; i < MAX_ADAPTERS && mLocAdapters[i] != adapter; i++) {
         if (mLocAdapters[i] == NULL) {
             mLocAdapters[i] = adapter;
+            rebuildEventAdapters(findExt(this), mLocAdapters);
             mMsgTask->sendMsg(new LocOpenMsg(this,
                                              (adapter->getEvtMask())));
             break;
@@ -193,6 +303,8 @@ void LocApiBase::removeAdapter(LocAdapterBase* adapter)
             mLocAdapters[j] = mLocAdapters[i];
             // this makes sure that we exit the for loop
             mLocAdapters[i] = NULL;
+            removeMasked(findExt(this), adapter);
+            rebuildEventAdapters(findExt(this), mLocAdapters);
 
             // if we have an empty list of adapters
             if (0 == i) {
@@ -207,9 +319,51 @@ void LocApiBase::removeAdapter(LocAdapterBase* adapter)
 
 void LocApiBase::updateEvtMask()
 {
+    rebuildEventAdapters(findExt(this), mLocAdapters);
     mMsgTask->sendMsg(new LocOpenMsg(this, getEvtMask()));
 }
 
+void LocApiBase::filterEventsByMask(LocAdapterBase* adapter)
+{
+    LocApiBaseExt* ext = findExt(this);
+
+    if (NULL != ext && !isMasked(ext, adapter)) {
+        for (int i = 0; i < MAX_ADAPTERS; i++) {
+            if (NULL == ext->maskedAdapters[i]) {
+                ext->maskedAdapters[i] = adapter;
+                break;
+            }
+        }
+        rebuildEventAdapters(ext, mLocAdapters);
+    }
+}
+
+// adapters that did not opt in keep getting every report, as they
+// did before the fan-out lists existed
+static void rebuildEventAdapters(LocApiBaseExt* ext, LocAdapterBase* const* locAdapters)
+{
+    if (NULL == ext) {
+        return;
+    }
+    for (int event = 0; event < LOC_API_FANOUT_MAX; event++) {
+        LocAdapterBase** subscribers = ext->eventAdapters[event];
+        int count = 0;
+
+        for (int i = 0; i < MAX_ADAPTERS && NULL != locAdapters[i]; i++) {
+            if (!isMasked(ext, locAdapters[i]) ||
+                (locAdapters[i]->getEvtMask() & sFanoutEventMasks[event])) {
+                subscribers[count++] = locAdapters[i];
+            }
+        }
+
+        // same packing rule as mLocAdapters: no holes, NULL terminated
+        // unless all the slots are taken
+        for (int i = count; i < MAX_ADAPTERS && NULL != subscribers[i]; i++) {
+            subscribers[i] = NULL;
+        }
+    }
+}
+
 void LocApiBase::handleEngineUpEvent()
 {
     // This will take care of renegotiating the loc handle
@@ -244,13 +398,15 @@ void LocApiBase::reportPosition(UlpLocation &location,
              location.gpsLocation.bearing, location.gpsLocation.accuracy,
              location.gpsLocation.timestamp, location.rawDataSize,
              location.rawData, status, loc_technology_mask);
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportPosition(location,
-                                        locationExtended,
-                                        locationExt,
-                                        status,
-                                        loc_technology_mask)
+    // everything reported below on this thread is timed from here
+    loc_latency_set_origin(loc_latency_stamp());
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_POSITION,
+        adapters[i]->reportPosition(location,
+                                    locationExtended,
+                                    locationExt,
+                                    status,
+                                    loc_technology_mask)
     );
 }
 
@@ -281,9 +437,9 @@ void LocApiBase::reportSv(GnssSvStatus &svStatus,
             svStatus.gnss_sv_list[i].azimuth,
             svStatus.gnss_sv_list[i].flags);
     }
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportSv(svStatus,
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_SV,
+        adapters[i]->reportSv(svStatus,
             locationExtended,
             svExt)
         );
@@ -291,17 +447,27 @@ void LocApiBase::reportSv(GnssSvStatus &svStatus,
 
 void LocApiBase::reportSvMeasurement(GnssSvMeasurementSet &svMeasurementSet)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportSvMeasurement(svMeasurementSet)
+    LocApiBaseExt* ext = findExt(this);
+    if (NULL != ext && NULL != ext->shmRing) {
+        ext->shmRing->publish(svMeasurementSet);
+    }
+
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_SV_MEASUREMENT,
+        adapters[i]->reportSvMeasurement(svMeasurementSet)
     );
 }
 
 void LocApiBase::reportSvPolynomial(GnssSvPolynomial &svPolynomial)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportSvPolynomial(svPolynomial)
+    LocApiBaseExt* ext = findExt(this);
+    if (NULL != ext && NULL != ext->shmRing) {
+        ext->shmRing->publish(svPolynomial);
+    }
+
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_POLYNOMIAL,
+        adapters[i]->reportSvPolynomial(svPolynomial)
     );
 }
 
@@ -313,8 +479,8 @@ void LocApiBase::reportStatus(GpsStatusValue status)
 
 void LocApiBase::reportNmea(const char* nmea, int length)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->reportNmea(nmea, length));
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_NMEA, adapters[i]->reportNmea(nmea, length));
 }
 
 void LocApiBase::reportXtraServer(const char* url1, const char* url2,
@@ -397,8 +563,8 @@ LocApiProxyBase* LocApiBase :: getLocApiProxy()
 
 void LocApiBase::reportGnssMeasurementData(GnssData &gnssMeasurementData)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->reportGnssMeasurementData(gnssMeasurementData));
+    // deliver only to the adapters subscribed to this event.
+    TO_EVENT_LOCADAPTERS(LOC_API_FANOUT_GNSS_MEASUREMENT, adapters[i]->reportGnssMeasurementData(gnssMeasurementData));
 }
 
 enum loc_api_adapter_err LocApiBase::
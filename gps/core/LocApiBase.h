@@ -54,6 +54,18 @@ int decodeAddress(char *addr_string, int string_size,
 #define TO_1ST_HANDLING_ADAPTER(adapters, call)                              \
     for (int i = 0; i <MAX_ADAPTERS && NULL != (adapters)[i] && !(call); i++);
 
+// High rate reports are only fanned out to the adapters whose event
+// mask asks for them, if they opted in with filterEventsByMask().
+enum loc_api_fanout_event {
+    LOC_API_FANOUT_POSITION = 0,
+    LOC_API_FANOUT_SV,
+    LOC_API_FANOUT_NMEA,
+    LOC_API_FANOUT_SV_MEASUREMENT,
+    LOC_API_FANOUT_GNSS_MEASUREMENT,
+    LOC_API_FANOUT_POLYNOMIAL,
+    LOC_API_FANOUT_MAX
+};
+
 enum xtra_version_check {
     DISABLED,
     AUTO,
@@ -105,6 +117,9 @@ public:
 
     void addAdapter(LocAdapterBase* adapter);
     void removeAdapter(LocAdapterBase* adapter);
+    // opts an adapter in to only getting the high rate reports its
+    // event mask selects; adapters that don't get all of them
+    void filterEventsByMask(LocAdapterBase* adapter);
 
     // upward calls
     void handleEngineUpEvent();
@@ -0,0 +1,206 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocShmRing"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <LocShmRing.h>
+#include <platform_lib_log_util.h>
+
+namespace loc_core {
+
+#define LOC_SHM_RING_ALIGN(x, a) (((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+LocShmRing::LocShmRing(int fd, size_t size, LocShmRingHeader* header) :
+    mFd(fd), mSize(size), mHeader(header)
+{
+}
+
+LocShmRing::~LocShmRing()
+{
+    munmap(mHeader, mSize);
+    close(mFd);
+}
+
+LocShmRing* LocShmRing::create(const char* path, uint32_t slotCount)
+{
+    size_t payloadSize = sizeof(GnssSvMeasurementSet);
+    if (payloadSize < sizeof(GnssSvPolynomial)) {
+        payloadSize = sizeof(GnssSvPolynomial);
+    }
+    size_t headerSize = LOC_SHM_RING_ALIGN(sizeof(LocShmRingHeader), 64);
+    size_t slotSize =
+        LOC_SHM_RING_ALIGN(sizeof(LocShmRingSlot) + payloadSize, 64);
+    size_t size = headerSize + slotSize * slotCount;
+
+    if (NULL == path || 0 == slotCount) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (fd < 0) {
+        LOC_LOGE("%s: open %s failed: %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        LOC_LOGE("%s: ftruncate %s failed: %s",
+                 __func__, path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (MAP_FAILED == base) {
+        LOC_LOGE("%s: mmap %s failed: %s", __func__, path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+
+    // the file was just truncated, so all the slots read as empty;
+    // the magic goes in last so readers never see a half set up header
+    LocShmRingHeader* header = (LocShmRingHeader*)base;
+    header->version = LOC_SHM_RING_VERSION;
+    header->headerSize = headerSize;
+    header->slotSize = slotSize;
+    header->slotCount = slotCount;
+    header->writeCount = 0;
+    __sync_synchronize();
+    header->magic = LOC_SHM_RING_MAGIC;
+
+    LOC_LOGD("%s: %s, %u slots of %u bytes", __func__, path,
+             slotCount, (uint32_t)slotSize);
+
+    return new LocShmRing(fd, size, header);
+}
+
+LocShmRingSlot* LocShmRing::slotAt(uint32_t entry) const
+{
+    return (LocShmRingSlot*)((char*)mHeader + mHeader->headerSize +
+                             (size_t)(entry % mHeader->slotCount) *
+                             mHeader->slotSize);
+}
+
+bool LocShmRing::publish(loc_shm_ring_entry_type type,
+                         const void* payload, size_t length)
+{
+    if (length > mHeader->slotSize - sizeof(LocShmRingSlot)) {
+        return false;
+    }
+
+    uint32_t entry = mHeader->writeCount;
+    LocShmRingSlot* slot = slotAt(entry);
+    uint32_t seq = slot->seq;
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0) {
+        ts.tv_sec = ts.tv_nsec = 0;
+    }
+
+    // odd sequence: readers of this slot will retry or skip it
+    slot->seq = seq + 1;
+    __sync_synchronize();
+
+    slot->entry = entry;
+    slot->type = type;
+    slot->length = length;
+    slot->timestampNs = (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    memcpy(slot + 1, payload, length);
+
+    __sync_synchronize();
+    slot->seq = seq + 2;
+    __sync_synchronize();
+    mHeader->writeCount = entry + 1;
+
+    return true;
+}
+
+bool LocShmRing::read(const LocShmRingHeader* ring, uint32_t& cursor,
+                      LocShmRingSlot& slot, void* payload,
+                      size_t payloadLength, uint32_t& lost)
+{
+    if (NULL == ring || LOC_SHM_RING_MAGIC != ring->magic ||
+        LOC_SHM_RING_VERSION != ring->version) {
+        return false;
+    }
+
+    for (;;) {
+        uint32_t written = ring->writeCount;
+        __sync_synchronize();
+
+        if (cursor == written) {
+            return false;
+        }
+        if (written - cursor > ring->slotCount) {
+            // lapped while away, jump to the oldest entry still there
+            lost += written - cursor - ring->slotCount;
+            cursor = written - ring->slotCount;
+        }
+
+        const LocShmRingSlot* shared = (const LocShmRingSlot*)
+            ((const char*)ring + ring->headerSize +
+             (size_t)(cursor % ring->slotCount) * ring->slotSize);
+        uint32_t seq = shared->seq;
+        __sync_synchronize();
+
+        if (0 == (seq & 1)) {
+            size_t length = shared->length;
+            if (length > ring->slotSize - sizeof(LocShmRingSlot)) {
+                length = ring->slotSize - sizeof(LocShmRingSlot);
+            }
+            slot.seq = seq;
+            slot.entry = shared->entry;
+            slot.type = shared->type;
+            slot.length = shared->length;
+            slot.timestampNs = shared->timestampNs;
+            if (NULL != payload) {
+                memcpy(payload, shared + 1,
+                       length < payloadLength ? length : payloadLength);
+            }
+            __sync_synchronize();
+
+            if (seq == shared->seq && cursor == slot.entry) {
+                cursor++;
+                return true;
+            }
+        }
+
+        // the writer has moved on to reuse this slot, so the entry
+        // under the cursor is gone
+        lost++;
+        cursor++;
+    }
+}
+
+} // namespace loc_core
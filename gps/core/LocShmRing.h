@@ -0,0 +1,115 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LOC_SHM_RING_H
+#define LOC_SHM_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <gps_extended.h>
+
+namespace loc_core {
+
+/* Shared memory ring of GNSS raw measurement and SV polynomial epochs.
+
+   The HAL is the only writer; any number of processes may mmap the
+   backing file read only and follow the ring with LocShmRing::read().
+   Each slot is protected by its own sequence count (odd while it is
+   being written), so readers never block the writer and find out by
+   themselves when they have been lapped. */
+
+#define LOC_SHM_RING_MAGIC            0x474e5352 /* "GNSR" */
+#define LOC_SHM_RING_VERSION          1
+#define LOC_SHM_RING_DEFAULT_SLOTS    32
+
+enum loc_shm_ring_entry_type {
+    LOC_SHM_RING_SV_MEASUREMENT = 1, /* payload is GnssSvMeasurementSet */
+    LOC_SHM_RING_SV_POLYNOMIAL  = 2  /* payload is GnssSvPolynomial */
+};
+
+/* at offset 0 of the mapping */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t slotSize;     /* including LocShmRingSlot */
+    uint32_t slotCount;
+    /* number of entries ever written; slot of entry n is n % slotCount */
+    volatile uint32_t writeCount;
+} LocShmRingHeader;
+
+/* slot i starts at headerSize + i * slotSize, payload follows */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t entry;        /* writeCount of this entry */
+    uint32_t type;         /* loc_shm_ring_entry_type */
+    uint32_t length;       /* payload bytes */
+    int64_t  timestampNs;  /* CLOCK_BOOTTIME when published */
+} LocShmRingSlot;
+
+class LocShmRing {
+    int mFd;
+    size_t mSize;
+    LocShmRingHeader* mHeader;
+
+    LocShmRing(int fd, size_t size, LocShmRingHeader* header);
+    LocShmRingSlot* slotAt(uint32_t entry) const;
+public:
+    // creates (or truncates) the file at path and maps it; returns
+    // NULL on any failure
+    static LocShmRing* create(const char* path,
+                              uint32_t slotCount = LOC_SHM_RING_DEFAULT_SLOTS);
+    ~LocShmRing();
+
+    // writer side, must only be called from one thread
+    bool publish(loc_shm_ring_entry_type type,
+                 const void* payload, size_t length);
+    inline bool publish(const GnssSvMeasurementSet& svMeasurementSet) {
+        return publish(LOC_SHM_RING_SV_MEASUREMENT,
+                       &svMeasurementSet, sizeof(svMeasurementSet));
+    }
+    inline bool publish(const GnssSvPolynomial& svPolynomial) {
+        return publish(LOC_SHM_RING_SV_POLYNOMIAL,
+                       &svPolynomial, sizeof(svPolynomial));
+    }
+
+    /* reader side, works on any read only mapping of the ring.
+       cursor is the next entry the reader wants; start with the
+       header's writeCount to only see new entries. On success the
+       slot header and up to payloadLength bytes of payload are copied
+       out, cursor moves past the entry and lost is bumped by the
+       number of entries the reader was lapped by.
+       Returns false when there is nothing new to read. */
+    static bool read(const LocShmRingHeader* ring, uint32_t& cursor,
+                     LocShmRingSlot& slot, void* payload,
+                     size_t payloadLength, uint32_t& lost);
+};
+
+} // namespace loc_core
+
+#endif //LOC_SHM_RING_H
@@ -188,6 +188,63 @@ typedef struct
     loc_ni_notify_callback notify_cb;
 } GpsNiExtCallbacks;
 
+/** Position batching interface, see LocGpsBatchingInterface. */
+#define LOC_GPS_BATCHING_INTERFACE "loc-gps-batching"
+
+/** When the batch is full, overwrite the oldest fix instead of handing
+ *  the batch up; fixes then only go up on the flush interval or an
+ *  explicit flush. */
+#define LOC_GPS_BATCHING_OVERWRITE_ON_FULL 0x0001
+
+/** Position batching options. */
+typedef struct {
+    /** set to sizeof(LocGpsBatchingOptions) */
+    size_t      size;
+    /** LOC_GPS_BATCHING_* flags */
+    uint32_t    flags;
+    /** ms the oldest batched fix is held before the batch is delivered,
+     *  0 to deliver on full / flush only */
+    uint32_t    flush_interval_ms;
+    /** fixes less than this many ms after the last batched one are
+     *  dropped, 0 to keep all */
+    uint32_t    min_interval_ms;
+    /** fixes less than this many meters from the last batched one are
+     *  dropped, 0 to keep all */
+    float       min_distance_m;
+} LocGpsBatchingOptions;
+
+/** Callback with num_locations batched fixes, oldest first. */
+typedef void (* loc_gps_batch_location_callback)(int num_locations,
+                                                 const GpsLocation* locations);
+
+/** Position batching callback structure. */
+typedef struct {
+    /** set to sizeof(LocGpsBatchingCallbacks) */
+    size_t      size;
+    loc_gps_batch_location_callback batch_location_cb;
+} LocGpsBatchingCallbacks;
+
+/** Extended interface for position batching. While batching is on, final
+ *  fixes are kept in a fixed size ring inside the HAL instead of being
+ *  reported one by one through location_cb. */
+typedef struct {
+    /** set to sizeof(LocGpsBatchingInterface) */
+    size_t      size;
+    /**
+     * Registers the batch callback. Without it, batched fixes are handed
+     * up through location_cb, back to back, when the batch is delivered.
+     */
+    int   (*init)(LocGpsBatchingCallbacks* callbacks);
+    /** Returns the number of fixes the batch holds. */
+    int   (*get_batch_size)(void);
+    /** Starts batching, or changes the options of an ongoing batching. */
+    int   (*start)(const LocGpsBatchingOptions* options);
+    /** Delivers what is left in the batch and stops batching. */
+    int   (*stop)(void);
+    /** Delivers the batch now. */
+    int   (*flush)(void);
+} LocGpsBatchingInterface;
+
 typedef enum loc_server_type {
     LOC_AGPS_CDMA_PDE_SERVER,
     LOC_AGPS_CUSTOM_PDE_SERVER,
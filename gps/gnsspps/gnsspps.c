@@ -28,6 +28,7 @@
 #include <platform_lib_log_util.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
@@ -35,16 +36,47 @@
 #include <pthread.h>
 #include <timepps.h>
 #include <linux/types.h>
+#include <gnsspps.h>
+
+#define NSEC_PER_SEC            1000000000LL
+/* an edge interval longer than this means at least one edge was missed */
+#define PPS_MISSED_EDGE_NS      (NSEC_PER_SEC + NSEC_PER_SEC / 2)
+/* jitter estimators use a 1/16 gain, as in RFC 3550 */
+#define PPS_JITTER_SHIFT        4
+/* readers give up after this many torn reads instead of spinning */
+#define PPS_READ_MAX_RETRIES    16
+
+/* PPS samples and statistics, published by the PPS thread with a
+   sequence lock: the writer makes seq odd while it updates and even
+   again when done, readers retry if seq was odd or changed under them.
+   Readers never block the PPS thread and take no locks themselves. */
+typedef struct {
+    volatile uint32_t seq;
+    uint32_t count;
+    gnss_pps_sample history[GNSS_PPS_HISTORY_SIZE];
+    gnss_pps_stats stats;
+} pps_publication;
+
+static pps_publication ppsPub;
+
+/* writer-only state used to update the statistics */
+static int64_t offsetSumNs = 0;
+static int64_t prevOffsetNs = 0;
+static struct timespec prevKernelTs = {0,0};
 
-//DRsync kernel timestamp
-static struct timespec drsyncKernelTs = {0,0};
-//DRsync userspace timestamp
-static struct timespec drsyncUserTs = {0,0};
 //flag to stop fetching timestamp
-static int isActive = 0;
+static volatile int isActive = 0;
 static pps_handle handle;
 
-static pthread_mutex_t ts_lock;
+static inline int64_t ts_to_ns(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static inline int64_t abs_ns(int64_t ns)
+{
+    return ns < 0 ? -ns : ns;
+}
 
   /*  checks the PPS source and opens it */
 int check_device(char *path, pps_handle *handle)
@@ -69,10 +101,97 @@ int check_device(char *path, pps_handle *handle)
      return 0;
 }
 
+/* updates the statistics for a new edge; called with the
+   publication open for writing */
+static void update_stats(gnss_pps_stats *stats,
+                         const struct timespec *kernelTs,
+                         const struct timespec *userTs)
+{
+    int64_t offsetNs = ts_to_ns(userTs) - ts_to_ns(kernelTs);
+
+    if (stats->edges == 0)
+    {
+        stats->minOffsetNs = offsetNs;
+        stats->maxOffsetNs = offsetNs;
+    }
+    else
+    {
+        int64_t intervalNs = ts_to_ns(kernelTs) - ts_to_ns(&prevKernelTs);
+
+        if (intervalNs > PPS_MISSED_EDGE_NS)
+        {
+            stats->missedEdges += (uint32_t)((intervalNs + NSEC_PER_SEC / 2) /
+                                             NSEC_PER_SEC) - 1;
+        }
+        else
+        {
+            stats->intervalJitterNs +=
+                (abs_ns(intervalNs - NSEC_PER_SEC) - stats->intervalJitterNs) >>
+                PPS_JITTER_SHIFT;
+        }
+        stats->offsetJitterNs +=
+            (abs_ns(offsetNs - prevOffsetNs) - stats->offsetJitterNs) >>
+            PPS_JITTER_SHIFT;
+
+        if (offsetNs < stats->minOffsetNs)
+        {
+            stats->minOffsetNs = offsetNs;
+        }
+        if (offsetNs > stats->maxOffsetNs)
+        {
+            stats->maxOffsetNs = offsetNs;
+        }
+    }
+
+    stats->edges++;
+    offsetSumNs += offsetNs;
+    stats->lastOffsetNs = offsetNs;
+    stats->meanOffsetNs = offsetSumNs / stats->edges;
+
+    prevOffsetNs = offsetNs;
+    prevKernelTs = *kernelTs;
+}
+
+/* publishes a new edge; only ever called from the PPS thread */
+static void publish_pps(const struct timespec *kernelTs,
+                        const struct timespec *userTs)
+{
+    gnss_pps_sample *sample;
+
+    ppsPub.seq++;
+    __sync_synchronize();
+
+    sample = &ppsPub.history[ppsPub.count % GNSS_PPS_HISTORY_SIZE];
+    sample->kernelTs = *kernelTs;
+    sample->userTs = *userTs;
+    ppsPub.count++;
+    update_stats(&ppsPub.stats, kernelTs, userTs);
+
+    __sync_synchronize();
+    ppsPub.seq++;
+}
+
+/* opens a read of the publication; returns the sequence to validate
+   against, or an odd value if the writer is busy */
+static inline uint32_t read_begin()
+{
+    uint32_t seq = ppsPub.seq;
+    __sync_synchronize();
+    return seq;
+}
+
+/* returns nonzero if the data copied since read_begin() is consistent */
+static inline int read_valid(uint32_t seq)
+{
+    __sync_synchronize();
+    return !(seq & 1) && seq == ppsPub.seq;
+}
+
 /* fetches the timestamp from the PPS source */
 int read_pps(pps_handle *handle)
 {
     struct timespec timeout;
+    struct timespec userTs;
     pps_info infobuf;
     int ret;
     // 3sec timeout
@@ -80,23 +199,31 @@ int read_pps(pps_handle *handle)
     timeout.tv_nsec = 0;
 
        ret = pps_fetch(*handle, PPS_TSFMT_TSPEC, &infobuf,&timeout);
-
-        if (ret < 0 && ret !=-EINTR)
+        // take the userspace timestamp as close to the edge as possible
+        if (clock_gettime(CLOCK_BOOTTIME, &userTs) != 0)
         {
-            LOC_LOGV("%s:%d pps_fetch() error %d", __func__, __LINE__,  ret);
-            return -1;
+            LOC_LOGV("%s:%d clock_gettime() error",__func__,__LINE__);
+            return 0;
         }
 
-        pthread_mutex_lock(&ts_lock);
-        drsyncKernelTs.tv_sec = infobuf.tv_sec;
-        drsyncKernelTs.tv_nsec = infobuf.tv_nsec;
-        ret = clock_gettime(CLOCK_BOOTTIME,&drsyncUserTs);
-        pthread_mutex_unlock(&ts_lock);
+        if (ret < 0)
+        {
+            if (ret != -EINTR)
+            {
+                LOC_LOGV("%s:%d pps_fetch() error %d", __func__, __LINE__,  ret);
+                return -1;
+            }
+            return 0;
+        }
 
-        if(ret != 0)
+        // an interrupted or timed out fetch may hand back the previous edge
+        if (infobuf.tv_sec == prevKernelTs.tv_sec &&
+            infobuf.tv_nsec == prevKernelTs.tv_nsec)
         {
-            LOC_LOGV("%s:%d clock_gettime() error",__func__,__LINE__);
+            return 0;
         }
+
+        publish_pps(&infobuf, &userTs);
     return 0;
 }
 
@@ -137,7 +264,10 @@ int initPPS(char *devname)
         return 0;
     }
 
-    pthread_mutex_init(&ts_lock,NULL);
+    memset(&ppsPub, 0, sizeof(ppsPub));
+    offsetSumNs = 0;
+    prevOffsetNs = 0;
+    memset(&prevKernelTs, 0, sizeof(prevKernelTs));
 
     pid = pthread_create(&thread,NULL,&thread_handle,NULL);
     if(pid != 0)
@@ -151,11 +281,9 @@ int initPPS(char *devname)
 /* stops fetching and closes the device */
 void deInitPPS()
 {
-    pthread_mutex_lock(&ts_lock);
     isActive = 0;
-    pthread_mutex_unlock(&ts_lock);
+    __sync_synchronize();
 
-    pthread_mutex_destroy(&ts_lock);
     pps_destroy(handle);
 }
 
@@ -170,16 +298,32 @@ int getPPS(struct timespec *fineKernelTs ,struct timespec *currentTs,
            struct timespec *fineUserTs)
 {
     int ret;
+    int retries = 0;
+    uint32_t seq;
 
-    pthread_mutex_lock(&ts_lock);
-    fineKernelTs->tv_sec = drsyncKernelTs.tv_sec;
-    fineKernelTs->tv_nsec = drsyncKernelTs.tv_nsec;
-
-    fineUserTs->tv_sec = drsyncUserTs.tv_sec;
-    fineUserTs->tv_nsec = drsyncUserTs.tv_nsec;
+    do
+    {
+        if (retries++ >= PPS_READ_MAX_RETRIES)
+        {
+            LOC_LOGV("%s:%d PPS publication busy", __func__, __LINE__);
+            return 0;
+        }
+        seq = read_begin();
+        if (ppsPub.count == 0)
+        {
+            memset(fineKernelTs, 0, sizeof(*fineKernelTs));
+            memset(fineUserTs, 0, sizeof(*fineUserTs));
+        }
+        else
+        {
+            const gnss_pps_sample *last =
+                &ppsPub.history[(ppsPub.count - 1) % GNSS_PPS_HISTORY_SIZE];
+            *fineKernelTs = last->kernelTs;
+            *fineUserTs = last->userTs;
+        }
+    } while (!read_valid(seq));
 
     ret = clock_gettime(CLOCK_BOOTTIME,currentTs);
-    pthread_mutex_unlock(&ts_lock);
     if(ret != 0)
     {
        LOC_LOGV("%s:%d clock_gettime() error",__func__,__LINE__);
@@ -188,7 +332,66 @@ int getPPS(struct timespec *fineKernelTs ,struct timespec *currentTs,
     return 1;
 }
 
+/* copies up to maxSamples of the most recent edges, newest first */
+int getPPSHistory(gnss_pps_sample *samples, int maxSamples)
+{
+    int retries = 0;
+    int n, i;
+    uint32_t seq, count;
+
+    if (samples == NULL || maxSamples <= 0)
+    {
+        return 0;
+    }
+
+    do
+    {
+        if (retries++ >= PPS_READ_MAX_RETRIES)
+        {
+            LOC_LOGV("%s:%d PPS publication busy", __func__, __LINE__);
+            return 0;
+        }
+        seq = read_begin();
+        count = ppsPub.count;
+        n = count < GNSS_PPS_HISTORY_SIZE ? (int)count : GNSS_PPS_HISTORY_SIZE;
+        if (n > maxSamples)
+        {
+            n = maxSamples;
+        }
+        for (i = 0; i < n; i++)
+        {
+            samples[i] = ppsPub.history[(count - 1 - i) % GNSS_PPS_HISTORY_SIZE];
+        }
+    } while (!read_valid(seq));
+
+    return n;
+}
+
+/* copies the jitter and offset statistics */
+int getPPSStats(gnss_pps_stats *stats)
+{
+    int retries = 0;
+    uint32_t seq;
+
+    if (stats == NULL)
+    {
+        return 0;
+    }
+
+    do
+    {
+        if (retries++ >= PPS_READ_MAX_RETRIES)
+        {
+            LOC_LOGV("%s:%d PPS publication busy", __func__, __LINE__);
+            return 0;
+        }
+        seq = read_begin();
+        *stats = ppsPub.stats;
+    } while (!read_valid(seq));
+
+    return 1;
+}
+
 #ifdef __cplusplus
 }
 #endif
-
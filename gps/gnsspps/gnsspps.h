@@ -28,16 +28,46 @@
 #ifndef _GNSSPPS_H
 #define _GNSSPPS_H
 
+#include <stdint.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* number of PPS edges kept in the history */
+#define GNSS_PPS_HISTORY_SIZE 16
+
+/* one PPS edge, as timestamped by the kernel and by userspace (BOOTTIME) */
+typedef struct {
+    struct timespec kernelTs;
+    struct timespec userTs;
+} gnss_pps_sample;
+
+/* offset is userspace minus kernel timestamp of an edge; jitter values
+   are smoothed mean deviations, interval jitter against the nominal 1s */
+typedef struct {
+    uint32_t edges;
+    uint32_t missedEdges;
+    int64_t lastOffsetNs;
+    int64_t minOffsetNs;
+    int64_t maxOffsetNs;
+    int64_t meanOffsetNs;
+    int64_t offsetJitterNs;
+    int64_t intervalJitterNs;
+} gnss_pps_stats;
+
 /*  opens the device and fetches from PPS source */
 int initPPS(char *devname);
 /* updates the fine time stamp */
 int getPPS(struct timespec *current_ts, struct timespec *current_boottime, struct timespec *last_boottime);
 /* stops fetching and closes the device */
 void deInitPPS();
+/* copies up to maxSamples of the most recent edges, newest first;
+   returns the number copied */
+int getPPSHistory(gnss_pps_sample *samples, int maxSamples);
+/* copies the offset and jitter statistics; returns 0 if unavailable */
+int getPPSStats(gnss_pps_stats *stats);
 
 #ifdef __cplusplus
 }
@@ -26,7 +26,9 @@ LOCAL_SRC_FILES += \
     loc_eng_ni.cpp \
     loc_eng_log.cpp \
     loc_eng_nmea.cpp \
-    LocEngAdapter.cpp
+    loc_eng_nmea_writer.cpp \
+    LocEngAdapter.cpp \
+    LocEngPositionBatch.cpp
 
 LOCAL_SRC_FILES += \
     loc_eng_dmn_conn.cpp \
@@ -39,6 +41,10 @@ LOCAL_CFLAGS += \
      -fno-short-enums \
      -D_ANDROID_
 
+ifeq ($(TARGET_BUILD_VARIANT),user)
+   LOCAL_CFLAGS += -DTARGET_BUILD_VARIANT_USER
+endif
+
 LOCAL_C_INCLUDES:= \
     $(TARGET_OUT_HEADERS)/gps.utils \
     $(TARGET_OUT_HEADERS)/libloc_core \
@@ -49,6 +55,7 @@ LOCAL_C_INCLUDES:= \
 LOCAL_COPY_HEADERS_TO:= libloc_eng/
 LOCAL_COPY_HEADERS:= \
    LocEngAdapter.h \
+   LocEngPositionBatch.h \
    loc.h \
    loc_eng.h \
    loc_eng_xtra.h \
@@ -34,6 +34,7 @@
 #include <ctype.h>
 #include <cutils/properties.h>
 #include <LocEngAdapter.h>
+#include <LocEngPositionBatch.h>
 #include "loc_eng_msg.h"
 #include "loc_log.h"
 
@@ -77,10 +78,15 @@ LocEngAdapter::LocEngAdapter(LOC_API_ADAPTER_EVENT_MASK_T mask,
     mSupportsAgpsRequests(false),
     mSupportsPositionInjection(false),
     mSupportsTimeInjection(false),
-    mPowerVote(0)
+    mPowerVote(0), mNmeaBatch(NULL), mPositionBatch(NULL)
 {
+    pthread_mutex_init(&mNmeaBatchLock, NULL);
+    mNmeaFlushId[0] = '\0';
+    mNmeaFlushCount = 0;
     memset(&mFixCriteria, 0, sizeof(mFixCriteria));
     mFixCriteria.mode = LOC_POSITION_MODE_INVALID;
+    // only take the high rate reports our event mask asks for
+    mLocApi->filterEventsByMask(this);
     LOC_LOGD("LocEngAdapter created");
 }
 
@@ -88,6 +94,9 @@ inline
 LocEngAdapter::~LocEngAdapter()
 {
     delete mInternalAdapter;
+    delete mNmeaBatch;
+    delete mPositionBatch;
+    pthread_mutex_destroy(&mNmeaBatchLock);
     LOC_LOGV("LocEngAdapter deleted");
 }
 
@@ -430,6 +439,12 @@ void LocInternalAdapter::reportStatus(GpsStatusValue status)
 
 void LocEngAdapter::reportStatus(GpsStatusValue status)
 {
+    if (GPS_STATUS_SESSION_END == status || GPS_STATUS_ENGINE_OFF == status) {
+        // the last epoch may not have reached its flush point
+        pthread_mutex_lock(&mNmeaBatchLock);
+        flushNmeaBatch();
+        pthread_mutex_unlock(&mNmeaBatchLock);
+    }
     if (!mUlp->reportStatus(status)) {
         mInternalAdapter->reportStatus(status);
     }
@@ -438,7 +453,58 @@ void LocEngAdapter::reportStatus(GpsStatusValue status)
 inline
 void LocEngAdapter::reportNmea(const char* nmea, int length)
 {
-    sendMsg(new LocEngReportNmea(mOwner, nmea, length));
+    pthread_mutex_lock(&mNmeaBatchLock);
+    if (0 == ContextBase::mGps_conf.NMEA_BATCH) {
+        flushNmeaBatch();
+        sendMsg(new LocEngReportNmea(mOwner, nmea, length));
+    } else {
+        const char* flushId = ContextBase::mGps_conf.NMEA_BATCH_FLUSH;
+        if (NULL != mNmeaBatch && mNmeaBatch->isNextEpoch(nmea, length)) {
+            // a whole epoch went by without a flush point: take its last
+            // sentence as the flush point so later epochs are not held
+            // back until the next one starts
+            if ('\0' == flushId[0]) {
+                mNmeaFlushCount = mNmeaBatch->lastSentenceId(
+                    mNmeaFlushId, sizeof(mNmeaFlushId));
+            }
+            flushNmeaBatch();
+        }
+        bool learned = '\0' == flushId[0];
+        if (learned) {
+            flushId = mNmeaFlushId;
+        }
+        if (NULL == mNmeaBatch) {
+            mNmeaBatch = new LocEngReportNmeaBatch(mOwner);
+        }
+        if (!mNmeaBatch->append(nmea, length)) {
+            flushNmeaBatch();
+            mNmeaBatch = new LocEngReportNmeaBatch(mOwner);
+            if (!mNmeaBatch->append(nmea, length)) {
+                // longer than a whole batch, send it on its own
+                sendMsg(new LocEngReportNmea(mOwner, nmea, length));
+            }
+        }
+        if (LocEngReportNmeaBatch::isFlushPoint(nmea, length, flushId)) {
+            char id[MAX_NMEA_SENTENCE_ID_LENGTH];
+            if (!learned || NULL == mNmeaBatch ||
+                mNmeaBatch->lastSentenceId(id, sizeof(id)) >= mNmeaFlushCount) {
+                flushNmeaBatch();
+            }
+        }
+    }
+    pthread_mutex_unlock(&mNmeaBatchLock);
+}
+
+void LocEngAdapter::flushNmeaBatch()
+{
+    if (NULL != mNmeaBatch) {
+        if (mNmeaBatch->mCount > 0) {
+            sendMsg(mNmeaBatch);
+        } else {
+            delete mNmeaBatch;
+        }
+        mNmeaBatch = NULL;
+    }
 }
 
 inline
@@ -598,3 +664,75 @@ bool LocEngAdapter::gnssConstellationConfig()
     result = mLocApi->gnssConstellationConfig();
     return result;
 }
+
+void LocEngAdapter::startPositionBatching(const LocGpsBatchingOptions& options)
+{
+    if (NULL == mPositionBatch) {
+        mPositionBatch = new LocEngPositionBatch(this, options);
+    } else {
+        mPositionBatch->setOptions(options);
+    }
+}
+
+void LocEngAdapter::stopPositionBatching()
+{
+    if (NULL != mPositionBatch) {
+        flushPositionBatch();
+        delete mPositionBatch;
+        mPositionBatch = NULL;
+    }
+}
+
+void LocEngAdapter::flushPositionBatch()
+{
+    if (NULL == mPositionBatch) {
+        return;
+    }
+
+    loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)mOwner;
+    int count = 0;
+    const GpsLocation* locations = mPositionBatch->drain(count);
+    LOC_LOGD("%s: %d fixes", __func__, count);
+    if (0 == count) {
+        return;
+    }
+
+    if (NULL != locEng->batch_location_cb) {
+        locEng->batch_location_cb(count, locations);
+    } else if (NULL != locEng->location_cb) {
+        UlpLocation location;
+        memset(&location, 0, sizeof(location));
+        location.size = sizeof(location);
+        location.position_source = ULP_LOCATION_IS_FROM_GNSS;
+        for (int i = 0; i < count; i++) {
+            location.gpsLocation = locations[i];
+            locEng->location_cb(&location, NULL);
+        }
+    }
+}
+
+void LocEngAdapter::requestPositionBatchFlush()
+{
+    struct LocEngFlushPositionBatch : public LocMsg {
+        LocEngAdapter* mAdapter;
+        inline LocEngFlushPositionBatch(LocEngAdapter* adapter) :
+            LocMsg(), mAdapter(adapter) {}
+        inline virtual void proc() const {
+            mAdapter->flushPositionBatch();
+        }
+    };
+
+    sendMsg(new LocEngFlushPositionBatch(this));
+}
+
+bool LocEngAdapter::batchPosition(const GpsLocation& location)
+{
+    if (NULL == mPositionBatch) {
+        return false;
+    }
+    if (!mPositionBatch->add(location)) {
+        flushPositionBatch();
+        mPositionBatch->add(location);
+    }
+    return true;
+}
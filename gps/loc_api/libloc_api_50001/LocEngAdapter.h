@@ -67,6 +67,9 @@ public:
 
 typedef void (*loc_msg_sender)(void* loc_eng_data_p, void* msgp);
 
+struct LocEngReportNmeaBatch;
+class LocEngPositionBatch;
+
 class LocEngAdapter : public LocAdapterBase {
     void* mOwner;
     LocInternalAdapter* mInternalAdapter;
@@ -79,6 +82,18 @@ class LocEngAdapter : public LocAdapterBase {
     unsigned int mPowerVote;
     static const unsigned int POWER_VOTE_RIGHT = 0x20;
     static const unsigned int POWER_VOTE_VALUE = 0x10;
+    // modem NMEA of the current epoch, pending until its flush point
+    pthread_mutex_t mNmeaBatchLock;
+    LocEngReportNmeaBatch* mNmeaBatch;
+    // last sentence id of a whole epoch and how many times the epoch
+    // had it, the flush point used when NMEA_BATCH_FLUSH is not set
+    char mNmeaFlushId[MAX_NMEA_SENTENCE_ID_LENGTH];
+    int mNmeaFlushCount;
+
+    // sends the pending NMEA batch up, if any; mNmeaBatchLock held
+    void flushNmeaBatch();
+    // fixes held back while position batching is on, NULL otherwise
+    LocEngPositionBatch* mPositionBatch;
 
 public:
     bool mSupportsAgpsRequests;
@@ -350,6 +365,17 @@ public:
       Set Gnss Constellation Config
      */
     bool gnssConstellationConfig();
+
+    /*
+      Position batching; to be called on the msg thread only, except for
+      requestPositionBatchFlush() which posts the flush there.
+     */
+    void startPositionBatching(const LocGpsBatchingOptions& options);
+    void stopPositionBatching();
+    void flushPositionBatch();
+    void requestPositionBatchFlush();
+    // true if the fix went into the batch instead of being reported
+    bool batchPosition(const GpsLocation& location);
 };
 
 #endif //LOC_API_ENG_ADAPTER_H
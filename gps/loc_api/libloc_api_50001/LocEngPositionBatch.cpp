@@ -0,0 +1,145 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_EngBatch"
+
+#include <math.h>
+#include <string.h>
+#include <LocEngPositionBatch.h>
+#include <LocEngAdapter.h>
+#include <platform_lib_includes.h>
+
+#define EARTH_RADIUS_M 6371009.0
+#define DEG_TO_RAD     (M_PI / 180.0)
+
+// equirectangular approximation, good enough for the short hops the
+// distance filter is about
+static double distanceMeters(const GpsLocation& a, const GpsLocation& b)
+{
+    double dLon = (b.longitude - a.longitude) * DEG_TO_RAD;
+    if (dLon > M_PI) {
+        dLon -= 2 * M_PI;
+    } else if (dLon < -M_PI) {
+        dLon += 2 * M_PI;
+    }
+    double x = dLon * cos((a.latitude + b.latitude) * DEG_TO_RAD / 2);
+    double y = (b.latitude - a.latitude) * DEG_TO_RAD;
+    return sqrt(x * x + y * y) * EARTH_RADIUS_M;
+}
+
+LocEngPositionBatch::LocEngPositionBatch(LocEngAdapter* adapter,
+                                         const LocGpsBatchingOptions& options) :
+    LocTimer(), mAdapter(adapter), mOldest(0), mCount(0), mHasLast(false)
+{
+    memset(&mOptions, 0, sizeof(mOptions));
+    setOptions(options);
+}
+
+LocEngPositionBatch::~LocEngPositionBatch()
+{
+    stop();
+}
+
+void LocEngPositionBatch::setOptions(const LocGpsBatchingOptions& options)
+{
+    mOptions = options;
+    LOC_LOGD("%s: flags 0x%x, flush interval %u ms, min interval %u ms, "
+             "min distance %f m", __func__, mOptions.flags,
+             mOptions.flush_interval_ms, mOptions.min_interval_ms,
+             mOptions.min_distance_m);
+    stop();
+    if (mCount > 0 && mOptions.flush_interval_ms > 0) {
+        start(mOptions.flush_interval_ms, true);
+    }
+}
+
+bool LocEngPositionBatch::isWanted(const GpsLocation& location) const
+{
+    if (!mHasLast) {
+        return true;
+    }
+    if (mOptions.min_interval_ms > 0 &&
+        location.timestamp >= mLast.timestamp &&
+        location.timestamp - mLast.timestamp < (GpsUtcTime)mOptions.min_interval_ms) {
+        return false;
+    }
+    if (mOptions.min_distance_m > 0 &&
+        (location.flags & GPS_LOCATION_HAS_LAT_LONG) &&
+        (mLast.flags & GPS_LOCATION_HAS_LAT_LONG) &&
+        distanceMeters(mLast, location) < mOptions.min_distance_m) {
+        return false;
+    }
+    return true;
+}
+
+bool LocEngPositionBatch::add(const GpsLocation& location)
+{
+    if (!isWanted(location)) {
+        return true;
+    }
+    if (LOC_ENG_POSITION_BATCH_SIZE == mCount) {
+        if (!(mOptions.flags & LOC_GPS_BATCHING_OVERWRITE_ON_FULL)) {
+            return false;
+        }
+        mOldest = (mOldest + 1) % LOC_ENG_POSITION_BATCH_SIZE;
+        mCount--;
+    }
+    mRing[(mOldest + mCount) % LOC_ENG_POSITION_BATCH_SIZE] = location;
+    mCount++;
+    mLast = location;
+    mHasLast = true;
+    // the interval runs from the oldest fix held, so an idle batch does
+    // not wake anybody up
+    if (1 == mCount && mOptions.flush_interval_ms > 0) {
+        start(mOptions.flush_interval_ms, true);
+    }
+    return true;
+}
+
+const GpsLocation* LocEngPositionBatch::drain(int& count)
+{
+    int tail = LOC_ENG_POSITION_BATCH_SIZE - mOldest;
+    if (mCount <= tail) {
+        memcpy(mDrained, &mRing[mOldest], mCount * sizeof(GpsLocation));
+    } else {
+        memcpy(mDrained, &mRing[mOldest], tail * sizeof(GpsLocation));
+        memcpy(&mDrained[tail], mRing, (mCount - tail) * sizeof(GpsLocation));
+    }
+    count = mCount;
+    mOldest = 0;
+    mCount = 0;
+
+    stop();
+    return mDrained;
+}
+
+void LocEngPositionBatch::timeOutCallback()
+{
+    mAdapter->requestPositionBatchFlush();
+}
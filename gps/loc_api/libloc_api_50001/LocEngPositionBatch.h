@@ -0,0 +1,78 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LOC_ENG_POSITION_BATCH_H
+#define LOC_ENG_POSITION_BATCH_H
+
+#include <hardware/gps.h>
+#include <gps_extended.h>
+#include <LocTimer.h>
+
+#define LOC_ENG_POSITION_BATCH_SIZE 128
+
+class LocEngAdapter;
+
+// Fixed size ring of fixes kept by the HAL while position batching is on.
+// It is only touched from the loc eng msg thread; the flush interval timer
+// merely posts a flush request there.
+class LocEngPositionBatch : public LocTimer {
+    LocEngAdapter* const mAdapter;
+    LocGpsBatchingOptions mOptions;
+    GpsLocation mRing[LOC_ENG_POSITION_BATCH_SIZE];
+    GpsLocation mDrained[LOC_ENG_POSITION_BATCH_SIZE];
+    int mOldest;
+    int mCount;
+    bool mHasLast;
+    GpsLocation mLast;
+
+    // distance / time filters against the last batched fix
+    bool isWanted(const GpsLocation& location) const;
+public:
+    LocEngPositionBatch(LocEngAdapter* adapter,
+                        const LocGpsBatchingOptions& options);
+    virtual ~LocEngPositionBatch();
+
+    // changes the options; rearms the interval timer if fixes are held
+    void setOptions(const LocGpsBatchingOptions& options);
+
+    // returns false if the batch is full and must be drained first.
+    // Filtered out fixes are dropped and count as added. The first fix
+    // of an empty batch arms the interval timer.
+    bool add(const GpsLocation& location);
+
+    // empties the batch; returns the fixes, oldest first, valid until the
+    // next drain(). Stops the interval timer until the next add().
+    const GpsLocation* drain(int& count);
+
+    inline int count() const { return mCount; }
+
+    // flush interval expired
+    virtual void timeOutCallback();
+};
+
+#endif // LOC_ENG_POSITION_BATCH_H
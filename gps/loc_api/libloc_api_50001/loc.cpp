@@ -45,6 +45,9 @@
 #include <LocDualContext.h>
 #include <platform_lib_includes.h>
 #include <cutils/properties.h>
+#include <LocLatency.h>
+#include <LocExecutor.h>
+#include <LocEngPositionBatch.h>
 
 using namespace loc_core;
 
@@ -141,6 +144,30 @@ static const GpsMeasurementInterface sLocEngGpsMeasurementInterface =
     loc_gps_measurement_close
 };
 
+static size_t loc_get_internal_state(char* buffer, size_t bufferSize);
+
+static const GpsDebugInterface sLocEngDebugInterface =
+{
+    sizeof(GpsDebugInterface),
+    loc_get_internal_state
+};
+
+static int loc_batching_init(LocGpsBatchingCallbacks* callbacks);
+static int loc_batching_get_batch_size();
+static int loc_batching_start(const LocGpsBatchingOptions* options);
+static int loc_batching_stop();
+static int loc_batching_flush();
+
+static const LocGpsBatchingInterface sLocEngBatchingInterface =
+{
+    sizeof(LocGpsBatchingInterface),
+    loc_batching_init,
+    loc_batching_get_batch_size,
+    loc_batching_start,
+    loc_batching_stop,
+    loc_batching_flush
+};
+
 static void loc_agps_ril_init( AGpsRilCallbacks* callbacks );
 static void loc_agps_ril_set_ref_location(const AGpsRefLocation *agps_reflocation, size_t sz_struct);
 static void loc_agps_ril_set_set_id(AGpsSetIDType type, const char* setid);
@@ -293,8 +320,11 @@ static int loc_init(GpsCallbacks* callbacks)
         return retVal;
     }
 
+    // LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT is only registered while the
+    // framework has a measurement callback, see
+    // loc_eng_gps_measurement_init(); until then the modem does not send
+    // the indications and the LocApi does not convert them
     event = LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT |
-            LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT |
             LOC_API_ADAPTER_BIT_SATELLITE_REPORT |
             LOC_API_ADAPTER_BIT_LOCATION_SERVER_REQUEST |
             LOC_API_ADAPTER_BIT_ASSISTANCE_DATA_REQUEST |
@@ -308,7 +338,8 @@ static int loc_init(GpsCallbacks* callbacks)
     /* If platform is "auto" and external dr enabled then enable
     ** Measurement report and SV Polynomial report
     */
-    if((1 == gps_conf.EXTERNAL_DR_ENABLED))
+    if((1 == gps_conf.EXTERNAL_DR_ENABLED) ||
+       ('\0' != gps_conf.GNSS_RAW_SHM_RING[0]))
     {
         event |= LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT_REPORT |
                 LOC_API_ADAPTER_BIT_GNSS_SV_POLYNOMIAL_REPORT;
@@ -672,6 +703,14 @@ const void* loc_get_extension(const char* name)
    {
        ret_val = &sLocEngGpsMeasurementInterface;
    }
+   else if (strcmp(name, GPS_DEBUG_INTERFACE) == 0)
+   {
+       ret_val = &sLocEngDebugInterface;
+   }
+   else if (strcmp(name, LOC_GPS_BATCHING_INTERFACE) == 0)
+   {
+       ret_val = &sLocEngBatchingInterface;
+   }
    else
    {
       LOC_LOGE ("get_extension: Invalid interface passed in\n");
@@ -976,6 +1015,165 @@ static void loc_gps_measurement_close()
     EXIT_LOG(%s, VOID_RET);
 }
 
+/*===========================================================================
+FUNCTION    loc_get_internal_state
+
+DESCRIPTION
+   This function fills the debug buffer with the report path latency
+   histograms and the msg strand stats; it backs "dumpsys location".
+
+DEPENDENCIES
+   Histograms are only filled while LATENCY_PROFILING is set in gps.conf
+
+RETURN VALUE
+   number of bytes written, excluding the terminating NUL
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static size_t loc_get_internal_state(char* buffer, size_t bufferSize)
+{
+    ENTRY_LOG();
+    size_t ret_val = loc_latency_dump(buffer, bufferSize);
+    if (ret_val < bufferSize) {
+        ret_val += LocExecutor::getInstance().dump(buffer + ret_val,
+                                                   bufferSize - ret_val);
+    }
+
+    EXIT_LOG(%zu, ret_val);
+    return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_batching_init
+
+DESCRIPTION
+   This function registers the position batching callbacks
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_batching_init(LocGpsBatchingCallbacks* callbacks)
+{
+    ENTRY_LOG();
+    int ret_val = loc_eng_batching_init(loc_afw_data, callbacks);
+
+    EXIT_LOG(%d, ret_val);
+    return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_batching_get_batch_size
+
+DESCRIPTION
+   This function returns how many fixes the position batch holds
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   batch size
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_batching_get_batch_size()
+{
+    ENTRY_LOG();
+    int ret_val = LOC_ENG_POSITION_BATCH_SIZE;
+
+    EXIT_LOG(%d, ret_val);
+    return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_batching_start
+
+DESCRIPTION
+   This function starts position batching
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_batching_start(const LocGpsBatchingOptions* options)
+{
+    ENTRY_LOG();
+    int ret_val = -1;
+
+    if (NULL != options) {
+        ret_val = loc_eng_batching_start(loc_afw_data, *options);
+    }
+
+    EXIT_LOG(%d, ret_val);
+    return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_batching_stop
+
+DESCRIPTION
+   This function stops position batching, handing up what is left
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_batching_stop()
+{
+    ENTRY_LOG();
+    int ret_val = loc_eng_batching_stop(loc_afw_data);
+
+    EXIT_LOG(%d, ret_val);
+    return ret_val;
+}
+
+/*===========================================================================
+FUNCTION    loc_batching_flush
+
+DESCRIPTION
+   This function hands up the position batch
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int loc_batching_flush()
+{
+    ENTRY_LOG();
+    int ret_val = loc_eng_batching_flush(loc_afw_data);
+
+    EXIT_LOG(%d, ret_val);
+    return ret_val;
+}
+
 /*===========================================================================
 FUNCTION    loc_ni_init
 
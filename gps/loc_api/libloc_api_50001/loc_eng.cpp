@@ -56,6 +56,7 @@
 #include <loc_eng_msg.h>
 #include <loc_eng_nmea.h>
 #include <msg_q.h>
+#include <LocLatency.h>
 #include <loc.h>
 #include <platform_lib_includes.h>
 #include "loc_core_log.h"
@@ -102,6 +103,19 @@ static const loc_param_s_type gps_conf_table[] =
   {"USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL",  &gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL,          NULL, 'n'},
   {"AGPS_CONFIG_INJECT",             &gps_conf.AGPS_CONFIG_INJECT,             NULL, 'n'},
   {"EXTERNAL_DR_ENABLED",            &gps_conf.EXTERNAL_DR_ENABLED,                  NULL, 'n'},
+  {"LATENCY_PROFILING",              &gps_conf.LATENCY_PROFILING,              NULL, 'n'},
+  {"NMEA_BATCH",                     &gps_conf.NMEA_BATCH,                     NULL, 'n'},
+  {"NMEA_BATCH_FLUSH",               &gps_conf.NMEA_BATCH_FLUSH,               NULL, 's'},
+  {"GNSS_RAW_SHM_RING",              &gps_conf.GNSS_RAW_SHM_RING,              NULL, 's'},
+};
+
+/* gps.conf items that are picked up again when gps.conf changes; only
+   plain numbers that are looked at afresh on every use */
+static const loc_param_s_type gps_conf_runtime_table[] =
+{
+  {"ACCURACY_THRES",                 &gps_conf.ACCURACY_THRES,                 NULL, 'n'},
+  {"LATENCY_PROFILING",              &gps_conf.LATENCY_PROFILING,              NULL, 'n'},
+  {"NMEA_BATCH",                     &gps_conf.NMEA_BATCH,                     NULL, 'n'},
 };
 
 static const loc_param_s_type sap_conf_table[] =
@@ -181,6 +195,16 @@ static void loc_default_parameters(void)
 
    /* inject supl config to modem with config values from config.xml or gps.conf, default 1 */
    gps_conf.AGPS_CONFIG_INJECT = 1;
+
+   /* report path latency stamping is off by default */
+   gps_conf.LATENCY_PROFILING = 0;
+
+   /* modem NMEA is sent up one sentence per message by default */
+   gps_conf.NMEA_BATCH = 0;
+   gps_conf.NMEA_BATCH_FLUSH[0] = '\0';
+
+   /* no shared memory ring of raw measurements by default */
+   gps_conf.GNSS_RAW_SHM_RING[0] = '\0';
 }
 
 // 2nd half of init(), singled out for
@@ -769,16 +793,22 @@ LocEngReportPosition::LocEngReportPosition(LocAdapterBase* adapter,
     mLocationExt(((loc_eng_data_s_type*)
                   ((LocEngAdapter*)
                    (mAdapter))->getOwner())->location_ext_parser(locExt)),
-    mStatus(st), mTechMask(technology)
+    mStatus(st), mTechMask(technology),
+    mOriginNs(loc_latency_get_origin()), mSentNs(loc_latency_stamp())
 {
+    loc_latency_record(LOC_LATENCY_ORIGIN_TO_MSG_SEND, mOriginNs, mSentNs);
     locallog();
 }
 void LocEngReportPosition::proc() const {
     LocEngAdapter* adapter = (LocEngAdapter*)mAdapter;
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)adapter->getOwner();
 
+    loc_latency_record_since(LOC_LATENCY_POSITION_QUEUE, mSentNs);
+
     if (locEng->mute_session_state != LOC_MUTE_SESS_IN_SESSION) {
         bool reported = false;
+        bool batched = false;
+        uint64_t cbStartNs = loc_latency_stamp();
         if (locEng->location_cb != NULL) {
             if (LOC_SESS_FAILURE == mStatus) {
                 // in case we want to handle the failure case
@@ -806,12 +836,22 @@ void LocEngReportPosition::proc() const {
                         (gps_conf.ACCURACY_THRES != 0) &&
                         (mLocation.gpsLocation.accuracy >
                          gps_conf.ACCURACY_THRES)))) {
-                locEng->location_cb((UlpLocation*)&(mLocation),
-                                    (void*)mLocationExt);
+                if (adapter->batchPosition(mLocation.gpsLocation)) {
+                    batched = true;
+                } else {
+                    locEng->location_cb((UlpLocation*)&(mLocation),
+                                        (void*)mLocationExt);
+                }
                 reported = true;
             }
         }
 
+        if (reported && !batched) {
+            uint64_t cbEndNs = loc_latency_stamp();
+            loc_latency_record(LOC_LATENCY_LOCATION_CB, cbStartNs, cbEndNs);
+            loc_latency_record(LOC_LATENCY_ORIGIN_TO_LOCATION_CB, mOriginNs, cbEndNs);
+        }
+
         // if we have reported this fix
         if (reported &&
             // and if this is a singleshot
@@ -938,8 +978,11 @@ void LocEngReportNmea::proc() const {
     gettimeofday(&tv, (struct timezone *) NULL);
     int64_t now = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
 
-    if (locEng->nmea_cb != NULL)
+    if (locEng->nmea_cb != NULL) {
+        uint64_t cbStartNs = loc_latency_stamp();
         locEng->nmea_cb(now, mNmea, mLen);
+        loc_latency_record_since(LOC_LATENCY_NMEA_CB, cbStartNs);
+    }
 }
 inline void LocEngReportNmea::locallog() const {
     LOC_LOGV("LocEngReportNmea");
@@ -948,6 +991,131 @@ inline void LocEngReportNmea::log() const {
     locallog();
 }
 
+// length of the sentence id, e.g. 5 for "$GPGGA,..."
+static int nmea_sentence_id_len(const char* data, int len)
+{
+    int i = 1;
+    while (i < len && data[i] != ',' && data[i] != '*') {
+        i++;
+    }
+    return i - 1;
+}
+
+// false for all but the last part of a multi part sentence, which
+// carries the part count and part number as its first two fields
+static bool nmea_is_last_part(const char* data, int len, int idLen)
+{
+    if (idLen < 3 || 0 != memcmp(data + 1 + idLen - 3, "GSV", 3)) {
+        return true;
+    }
+    int fields[2] = {0, 0};
+    int i = idLen + 2;
+    for (int f = 0; f < 2; f++, i++) {
+        while (i < len && data[i] >= '0' && data[i] <= '9') {
+            fields[f] = fields[f] * 10 + data[i++] - '0';
+        }
+        if (i >= len || data[i] != ',') {
+            return true;
+        }
+    }
+    return fields[1] >= fields[0];
+}
+
+//        case LOC_ENG_MSG_REPORT_NMEA_BATCH:
+LocEngReportNmeaBatch::LocEngReportNmeaBatch(void* locEng) :
+    LocMsg(), mLocEng(locEng), mNmea(new char[LOC_ENG_NMEA_BATCH_SIZE]),
+    mLen(0), mCount(0)
+{
+    locallog();
+}
+bool LocEngReportNmeaBatch::append(const char* data, int len)
+{
+    if (len < 0 || mCount >= LOC_ENG_NMEA_BATCH_MAX_SENTENCES ||
+        mLen + len + 1 > LOC_ENG_NMEA_BATCH_SIZE) {
+        return false;
+    }
+    memcpy(mNmea + mLen, data, len);
+    mNmea[mLen + len] = '\0';
+    mLens[mCount++] = len;
+    mLen += len + 1;
+    return true;
+}
+bool LocEngReportNmeaBatch::isNextEpoch(const char* data, int len) const
+{
+    if (0 == mCount) {
+        return false;
+    }
+    const char* first = mNmea;
+    const char* last = mNmea + mLen - mLens[mCount - 1] - 1;
+    int idLen = nmea_sentence_id_len(data, len);
+    int firstIdLen = nmea_sentence_id_len(first, mLens[0]);
+    int lastIdLen = nmea_sentence_id_len(last, mLens[mCount - 1]);
+
+    // multi part sentences such as $GPGSV repeat their id back to back
+    return idLen == firstIdLen && 0 == memcmp(data, first, idLen + 1) &&
+           !(lastIdLen == firstIdLen && 0 == memcmp(last, first, idLen + 1));
+}
+int LocEngReportNmeaBatch::lastSentenceId(char* id, int size) const
+{
+    id[0] = '\0';
+    if (0 == mCount) {
+        return 0;
+    }
+    const char* last = mNmea + mLen - mLens[mCount - 1] - 1;
+    int idLen = nmea_sentence_id_len(last, mLens[mCount - 1]);
+    if (idLen >= size) {
+        return 0;
+    }
+    memcpy(id, last + 1, idLen);
+    id[idLen] = '\0';
+
+    // an id can be sent more than once a fix, e.g. $GNGSA once per
+    // constellation, and not always back to back
+    int count = 0;
+    const char* nmea = mNmea;
+    for (int i = 0; i < mCount; i++) {
+        if (nmea_sentence_id_len(nmea, mLens[i]) == idLen &&
+            0 == memcmp(nmea, last, idLen + 1) &&
+            nmea_is_last_part(nmea, mLens[i], idLen)) {
+            count++;
+        }
+        nmea += mLens[i] + 1;
+    }
+    return count;
+}
+bool LocEngReportNmeaBatch::isFlushPoint(const char* data, int len,
+                                         const char* flushId)
+{
+    int flushIdLen = strlen(flushId);
+    int idLen = nmea_sentence_id_len(data, len);
+    return flushIdLen > 0 && flushIdLen <= idLen &&
+           0 == memcmp(data + 1 + idLen - flushIdLen, flushId, flushIdLen) &&
+           nmea_is_last_part(data, len, idLen);
+}
+void LocEngReportNmeaBatch::proc() const {
+    loc_eng_data_s_type* locEng = (loc_eng_data_s_type*) mLocEng;
+
+    if (locEng->nmea_cb != NULL) {
+        struct timeval tv;
+        gettimeofday(&tv, (struct timezone *) NULL);
+        int64_t now = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+
+        const char* nmea = mNmea;
+        for (int i = 0; i < mCount; i++) {
+            uint64_t cbStartNs = loc_latency_stamp();
+            locEng->nmea_cb(now, nmea, mLens[i]);
+            loc_latency_record_since(LOC_LATENCY_NMEA_CB, cbStartNs);
+            nmea += mLens[i] + 1;
+        }
+    }
+}
+inline void LocEngReportNmeaBatch::locallog() const {
+    LOC_LOGV("LocEngReportNmeaBatch");
+}
+inline void LocEngReportNmeaBatch::log() const {
+    LOC_LOGV("LocEngReportNmeaBatch: %d sentences, %d bytes", mCount, mLen);
+}
+
 //        case LOC_ENG_MSG_REPORT_XTRA_SERVER:
 LocEngReportXtraServer::LocEngReportXtraServer(void* locEng,
                                                const char *url1,
@@ -1729,6 +1897,38 @@ inline void LocEngReportGnssMeasurement::log() const {
   }
 #define INIT_CHECK(ctx, ret) STATE_CHECK(ctx, "instance not initialized", ret)
 
+// gps.conf changed: read the runtime settings again on the msg thread,
+// where the rest of gps_conf is read
+struct LocEngConfChanged : public LocMsg {
+    const char* const mConfFileName;
+    inline LocEngConfChanged(const char* confFileName) :
+        LocMsg(), mConfFileName(confFileName)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        UTIL_READ_CONF(mConfFileName, gps_conf_runtime_table);
+        loc_latency_enable(gps_conf.LATENCY_PROFILING != 0);
+    }
+    inline void locallog() const {
+        LOC_LOGV("%s changed", mConfFileName);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+// called on the conf watcher thread
+static void loc_eng_conf_changed(const char* conf_file_name, void* user_data)
+{
+    loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)user_data;
+    LocEngAdapter* adapter = locEng->adapter;
+
+    if (NULL != adapter) {
+        adapter->sendMsg(new LocEngConfChanged(conf_file_name));
+    }
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_init
 
@@ -1806,6 +2006,13 @@ int loc_eng_init(loc_eng_data_s_type &loc_eng_data, LocCallbacks* callbacks,
              loc_eng_data.adapter);
     loc_eng_data.adapter->sendMsg(new LocEngInit(&loc_eng_data));
 
+    // loc_eng_data outlives the watch, which can not be taken back
+    static bool confWatched = false;
+    if (!confWatched) {
+        confWatched = (0 == loc_watch_conf(GPS_CONF_FILE, loc_eng_conf_changed,
+                                           &loc_eng_data));
+    }
+
     EXIT_LOG(%d, ret_val);
     return ret_val;
 }
@@ -2952,6 +3159,7 @@ int loc_eng_read_config(void)
       // In fact one day the conf file should go into context.
       UTIL_READ_CONF(GPS_CONF_FILE, gps_conf_table);
       UTIL_READ_CONF(SAP_CONF_FILE, sap_conf_table);
+      loc_latency_enable(gps_conf.LATENCY_PROFILING != 0);
       configAlreadyRead = true;
     } else {
       LOC_LOGV("GPS Config file has already been read\n");
@@ -3031,3 +3239,146 @@ void loc_eng_gps_measurement_close(loc_eng_data_s_type &loc_eng_data)
     loc_eng_data.gnss_measurement_cb = NULL;
     EXIT_LOG(%d, 0);
 }
+
+/*===========================================================================
+FUNCTION    loc_eng_batching_init
+
+DESCRIPTION
+   Registers the callback batched fixes are handed up with.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_batching_init(loc_eng_data_s_type &loc_eng_data,
+                          LocGpsBatchingCallbacks* callbacks)
+{
+    ENTRY_LOG_CALLFLOW();
+    STATE_CHECK((callbacks != NULL),
+                "callbacks can not be NULL",
+                return -1);
+
+    loc_eng_data.batch_location_cb = callbacks->batch_location_cb;
+
+    EXIT_LOG(%d, 0);
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batching_start
+
+DESCRIPTION
+   Starts keeping final fixes in the HAL position batch, or updates the
+   options of the ongoing batching.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_batching_start(loc_eng_data_s_type &loc_eng_data,
+                           const LocGpsBatchingOptions &options)
+{
+    ENTRY_LOG_CALLFLOW();
+    INIT_CHECK(loc_eng_data.adapter, return -1);
+
+    struct LocEngStartBatching : public LocMsg {
+        LocEngAdapter* mAdapter;
+        LocGpsBatchingOptions mOptions;
+        inline LocEngStartBatching(LocEngAdapter* adapter,
+                                   const LocGpsBatchingOptions &options) :
+            LocMsg(), mAdapter(adapter), mOptions(options)
+        {
+            locallog();
+        }
+        inline virtual void proc() const {
+            mAdapter->startPositionBatching(mOptions);
+        }
+        inline void locallog() const {
+            LOC_LOGV("LocEngStartBatching - flush interval: %u",
+                     mOptions.flush_interval_ms);
+        }
+        inline virtual void log() const {
+            locallog();
+        }
+    };
+    loc_eng_data.adapter->sendMsg(new LocEngStartBatching(loc_eng_data.adapter,
+                                                          options));
+
+    EXIT_LOG(%d, 0);
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batching_stop
+
+DESCRIPTION
+   Hands up what is left in the position batch and goes back to reporting
+   fixes one by one.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_batching_stop(loc_eng_data_s_type &loc_eng_data)
+{
+    ENTRY_LOG_CALLFLOW();
+    INIT_CHECK(loc_eng_data.adapter, return -1);
+
+    struct LocEngStopBatching : public LocMsg {
+        LocEngAdapter* mAdapter;
+        inline LocEngStopBatching(LocEngAdapter* adapter) :
+            LocMsg(), mAdapter(adapter) {}
+        inline virtual void proc() const {
+            mAdapter->stopPositionBatching();
+        }
+    };
+    loc_eng_data.adapter->sendMsg(new LocEngStopBatching(loc_eng_data.adapter));
+
+    EXIT_LOG(%d, 0);
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batching_flush
+
+DESCRIPTION
+   Hands up the position batch now.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+int loc_eng_batching_flush(loc_eng_data_s_type &loc_eng_data)
+{
+    ENTRY_LOG_CALLFLOW();
+    INIT_CHECK(loc_eng_data.adapter, return -1);
+
+    loc_eng_data.adapter->requestPositionBatchFlush();
+
+    EXIT_LOG(%d, 0);
+    return 0;
+}
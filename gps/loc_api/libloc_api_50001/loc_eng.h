@@ -139,6 +139,9 @@ typedef struct loc_eng_data_s
 
     loc_ext_parser location_ext_parser;
     loc_ext_parser sv_ext_parser;
+
+    // For position batching
+    loc_gps_batch_location_callback batch_location_cb;
 } loc_eng_data_s_type;
 
 //loc_eng functions
@@ -202,6 +205,12 @@ void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
 int loc_eng_gps_measurement_init(loc_eng_data_s_type &loc_eng_data,
                                  GpsMeasurementCallbacks* callbacks);
 void loc_eng_gps_measurement_close(loc_eng_data_s_type &loc_eng_data);
+int loc_eng_batching_init(loc_eng_data_s_type &loc_eng_data,
+                          LocGpsBatchingCallbacks* callbacks);
+int loc_eng_batching_start(loc_eng_data_s_type &loc_eng_data,
+                           const LocGpsBatchingOptions &options);
+int loc_eng_batching_stop(loc_eng_data_s_type &loc_eng_data);
+int loc_eng_batching_flush(loc_eng_data_s_type &loc_eng_data);
 
 #ifdef __cplusplus
 }
@@ -220,3 +220,103 @@ int loc_eng_dmn_conn_glue_msgflush(int msgqid)
     return length;
 }
 
+
+#ifdef __LOC_DEBUG__
+
+/* Round trip benchmark of the daemon connection: a daemon side sends
+   GPSONE_LOC_API_IF_REQUEST on the request queue, the HAL side receives
+   it with msgrcv and answers with msgsnd on the response queue, the same
+   path a SUPL data connection request takes.
+
+   on linux command line:
+   compile: gcc -D__LOC_DEBUG__ -O2 -I. -I../../utils -I<pla include> \
+       loc_eng_dmn_conn_glue_msg.c loc_eng_dmn_conn_glue_pipe.c -lpthread
+   run: ./a.out [round trips] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#define BENCH_REQ_Q  "/tmp/loc_eng_dmn_conn_bench_q"
+#define BENCH_RESP_Q "/tmp/loc_eng_dmn_conn_bench_resp_q"
+
+static int bench_req_qid, bench_resp_qid;
+
+static void * bench_hal(void * arg)
+{
+    struct ctrl_msgbuf msg;
+    (void) arg;
+
+    while (loc_eng_dmn_conn_glue_msgrcv(bench_req_qid, &msg, sizeof(msg)) > 0 &&
+           msg.ctrl_type != GPSONE_UNBLOCK) {
+        msg.ctrl_type = GPSONE_LOC_API_RESPONSE;
+        msg.cmsg.cmsg_response.result = GPSONE_LOC_API_IF_REQUEST_SUCCESS;
+        loc_eng_dmn_conn_glue_msgsnd(bench_resp_qid, &msg, sizeof(msg));
+    }
+    return NULL;
+}
+
+static int bench_cmp(const void * a, const void * b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char ** argv)
+{
+    struct ctrl_msgbuf req, resp;
+    struct timespec t0, t1;
+    long long * lat;
+    long long sum = 0;
+    pthread_t hal;
+    int n = argc > 1 ? atoi(argv[1]) : 10000;
+    int req_fd, resp_fd, i;
+
+    if (n <= 0) {
+        n = 10000;
+    }
+    lat = (long long *) malloc(n * sizeof(long long));
+
+    bench_req_qid = loc_eng_dmn_conn_glue_msgget(BENCH_REQ_Q, O_RDWR);
+    bench_resp_qid = loc_eng_dmn_conn_glue_msgget(BENCH_RESP_Q, O_RDWR);
+    req_fd = open(BENCH_REQ_Q, O_RDWR);
+    resp_fd = open(BENCH_RESP_Q, O_RDWR);
+    pthread_create(&hal, NULL, bench_hal, NULL);
+
+    memset(&req, 0, sizeof(req));
+    req.msgsz = sizeof(req);
+    req.ctrl_type = GPSONE_LOC_API_IF_REQUEST;
+    req.cmsg.cmsg_if_request.type = IF_REQUEST_TYPE_SUPL;
+    req.cmsg.cmsg_if_request.sender_id = IF_REQUEST_SENDER_ID_GPSONE_DAEMON;
+
+    for (i = 0; i < n; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (write(req_fd, &req, sizeof(req)) != sizeof(req) ||
+            read(resp_fd, &resp, sizeof(resp)) != sizeof(resp)) {
+            perror("round trip");
+            return 1;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        lat[i] = (t1.tv_sec - t0.tv_sec) * 1000000000LL + t1.tv_nsec - t0.tv_nsec;
+        sum += lat[i];
+    }
+
+    req.ctrl_type = GPSONE_UNBLOCK;
+    write(req_fd, &req, sizeof(req));
+    pthread_join(hal, NULL);
+
+    qsort(lat, n, sizeof(long long), bench_cmp);
+    printf("round trip ns: mean %lld p50 %lld p99 %lld max %lld\n",
+           sum / n, lat[n / 2], lat[n * 99 / 100], lat[n - 1]);
+
+    close(req_fd);
+    close(resp_fd);
+    loc_eng_dmn_conn_glue_msgremove(BENCH_REQ_Q, bench_req_qid);
+    loc_eng_dmn_conn_glue_msgremove(BENCH_RESP_Q, bench_resp_qid);
+    free(lat);
+    return 0;
+}
+
+#endif
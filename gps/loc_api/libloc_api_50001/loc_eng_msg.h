@@ -91,6 +91,9 @@ struct LocEngReportPosition : public LocMsg {
     const void* mLocationExt;
     const enum loc_sess_status mStatus;
     const LocPosTechMask mTechMask;
+    // latency stamps, 0 unless LocLatency stamping is on
+    const uint64_t mOriginNs;
+    const uint64_t mSentNs;
     LocEngReportPosition(LocAdapterBase* adapter,
                          UlpLocation &loc,
                          GpsLocationExtended &locExtended,
@@ -143,6 +146,40 @@ struct LocEngReportNmea : public LocMsg {
     virtual void log() const;
 };
 
+#define LOC_ENG_NMEA_BATCH_SIZE           4096
+#define LOC_ENG_NMEA_BATCH_MAX_SENTENCES  64
+
+// NMEA sentences of one fix, sent up in a single message and handed to
+// nmea_cb back to back with one timestamp. Sentences are stored NUL
+// terminated, one after the other, in mNmea.
+struct LocEngReportNmeaBatch : public LocMsg {
+    void* mLocEng;
+    char* const mNmea;
+    int mLen;
+    int mCount;
+    uint16_t mLens[LOC_ENG_NMEA_BATCH_MAX_SENTENCES];
+    LocEngReportNmeaBatch(void* locEng);
+    inline virtual ~LocEngReportNmeaBatch()
+    {
+        delete[] mNmea;
+    }
+    // false if the sentence does not fit, the batch is left untouched
+    bool append(const char* data, int len);
+    // true if the sentence opens the next epoch, i.e. it repeats the
+    // first sentence id of the batch after other ids have been seen
+    bool isNextEpoch(const char* data, int len) const;
+    // copies the id of the last sentence, e.g. "GNGSA", into id and
+    // returns how many times the batch has it, counting multi part
+    // sentences once
+    int lastSentenceId(char* id, int size) const;
+    // true if the sentence id ends with flushId, e.g. "VTG" or "GPVTG",
+    // and it is the last part of a multi part sentence such as $GPGSV
+    static bool isFlushPoint(const char* data, int len, const char* flushId);
+    virtual void proc() const;
+    void locallog() const;
+    virtual void log() const;
+};
+
 struct LocEngReportXtraServer : public LocMsg {
     void* mLocEng;
     int mMaxLen;
@@ -31,9 +31,31 @@
 #define LOG_TAG "LocSvc_eng_nmea"
 #include <loc_eng.h>
 #include <loc_eng_nmea.h>
+#include <loc_eng_nmea_writer.h>
 #include <math.h>
+#include <LocLatency.h>
 #include <platform_lib_includes.h>
 
+// current UTC time in ms, the timestamp handed to nmea_cb
+static int64_t loc_eng_nmea_now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, (struct timezone *) NULL);
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
+// all sentences generated for one report share one timestamp
+static void loc_eng_nmea_send_at(int64_t now, char *pNmea, int length,
+                                 loc_eng_data_s_type *loc_eng_data_p)
+{
+    if (loc_eng_data_p->nmea_cb != NULL) {
+        uint64_t cbStartNs = loc_latency_stamp();
+        loc_eng_data_p->nmea_cb(now, pNmea, length);
+        loc_latency_record_since(LOC_LATENCY_NMEA_CB, cbStartNs);
+    }
+    LOC_LOGD("NMEA <%s", pNmea);
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_nmea_send
 
@@ -52,12 +74,7 @@ SIDE EFFECTS
 ===========================================================================*/
 void loc_eng_nmea_send(char *pNmea, int length, loc_eng_data_s_type *loc_eng_data_p)
 {
-    struct timeval tv;
-    gettimeofday(&tv, (struct timezone *) NULL);
-    int64_t now = tv.tv_sec * 1000LL + tv.tv_usec / 1000;
-    if (loc_eng_data_p->nmea_cb != NULL)
-        loc_eng_data_p->nmea_cb(now, pNmea, length);
-    LOC_LOGD("NMEA <%s", pNmea);
+    loc_eng_nmea_send_at(loc_eng_nmea_now(), pNmea, length, loc_eng_data_p);
 }
 
 /*===========================================================================
@@ -96,6 +113,127 @@ int loc_eng_nmea_put_checksum(char *pNmea, int maxSize)
     return (length + checksumLength + 1);
 }
 
+/*===========================================================================
+FUNCTION    loc_eng_nmea_finish
+
+DESCRIPTION
+   Append the checksum to the sentence held by the writer and send it out
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   false if the sentence did not fit in its buffer, true otherwise
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static bool loc_eng_nmea_finish(LocEngNmeaWriter &writer, char *pNmea,
+                                int64_t now, loc_eng_data_s_type *loc_eng_data_p)
+{
+    int length = writer.finish();
+    if (length < 0)
+    {
+        LOC_LOGE("NMEA Error in string formatting");
+        return false;
+    }
+    loc_eng_nmea_send_at(now, pNmea, length, loc_eng_data_p);
+    return true;
+}
+
+// "hhmmss.ss," UTC time field
+static void loc_eng_nmea_put_utc_time(LocEngNmeaWriter &writer, int hours,
+                                      int minutes, int seconds, int mseconds)
+{
+    writer.putInt(hours, 2);
+    writer.putInt(minutes, 2);
+    writer.putInt(seconds, 2);
+    writer.putChar('.');
+    writer.putInt(mseconds/10, 2);
+    writer.putChar(',');
+}
+
+// "llmm.mmmmmm,a,yyymm.mmmmmm,a," position fields, empty when there is no fix
+static void loc_eng_nmea_put_lat_long(LocEngNmeaWriter &writer,
+                                      const UlpLocation &location)
+{
+    if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
+    {
+        double latitude = location.gpsLocation.latitude;
+        double longitude = location.gpsLocation.longitude;
+        char latHemisphere;
+        char lonHemisphere;
+        double latMinutes;
+        double lonMinutes;
+
+        if (latitude > 0)
+        {
+            latHemisphere = 'N';
+        }
+        else
+        {
+            latHemisphere = 'S';
+            latitude *= -1.0;
+        }
+
+        if (longitude < 0)
+        {
+            lonHemisphere = 'W';
+            longitude *= -1.0;
+        }
+        else
+        {
+            lonHemisphere = 'E';
+        }
+
+        latMinutes = fmod(latitude * 60.0 , 60.0);
+        lonMinutes = fmod(longitude * 60.0 , 60.0);
+
+        writer.putInt((uint8_t)floor(latitude), 2);
+        writer.putFixed(latMinutes, 6, 9);
+        writer.putChar(',');
+        writer.putChar(latHemisphere);
+        writer.putChar(',');
+        writer.putInt((uint8_t)floor(longitude), 3);
+        writer.putFixed(lonMinutes, 6, 9);
+        writer.putChar(',');
+        writer.putChar(lonHemisphere);
+        writer.putChar(',');
+    }
+    else
+    {
+        writer.putStr(",,,,");
+    }
+}
+
+// "p.p,h.h,v.v" DOP fields of $--GSA
+static void loc_eng_nmea_put_dop(LocEngNmeaWriter &writer,
+                                 const loc_eng_data_s_type *loc_eng_data_p,
+                                 const GpsLocationExtended &locationExtended)
+{
+    if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
+    {   // dop is in locationExtended, (QMI)
+        writer.putFixed(locationExtended.pdop, 1);
+        writer.putChar(',');
+        writer.putFixed(locationExtended.hdop, 1);
+        writer.putChar(',');
+        writer.putFixed(locationExtended.vdop, 1);
+    }
+    else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
+    {   // dop was cached from sv report (RPC)
+        writer.putFixed(loc_eng_data_p->pdop, 1);
+        writer.putChar(',');
+        writer.putFixed(loc_eng_data_p->hdop, 1);
+        writer.putChar(',');
+        writer.putFixed(loc_eng_data_p->vdop, 1);
+    }
+    else
+    {   // no dop
+        writer.putStr(",,");
+    }
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_nmea_generate_pos
 
@@ -132,9 +270,8 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
     }
 
     char sentence[NMEA_SENTENCE_MAX_LENGTH] = {0};
-    char* pMarker = sentence;
-    int lengthRemaining = sizeof(sentence);
-    int length = 0;
+    LocEngNmeaWriter writer(sentence, sizeof(sentence));
+    int64_t now = loc_eng_nmea_now();
     int utcYear = pTm->tm_year % 100; // 2 digit year
     int utcMonth = pTm->tm_mon + 1; // tm_mon starts at zero
     int utcDay = pTm->tm_mday;
@@ -168,53 +305,21 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         else
             fixType = '3'; // 3D fix
 
-        length = snprintf(pMarker, lengthRemaining, "$GPGSA,A,%c,", fixType);
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        writer.begin("GPGSA,A,");
+        writer.putChar(fixType);
+        writer.putChar(',');
 
         for (uint8_t i = 0; i < 12; i++) // only the first 12 sv go in sentence
         {
             if (i < svUsedCount)
-                length = snprintf(pMarker, lengthRemaining, "%02d,", svUsedList[i]);
-            else
-                length = snprintf(pMarker, lengthRemaining, ",");
-
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
+                writer.putInt(svUsedList[i], 2);
+            writer.putChar(',');
         }
 
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
-        {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              locationExtended.pdop,
-                              locationExtended.hdop,
-                              locationExtended.vdop);
-        }
-        else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
-        {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              loc_eng_data_p->pdop,
-                              loc_eng_data_p->hdop,
-                              loc_eng_data_p->vdop);
-        }
-        else
-        {   // no dop
-            length = snprintf(pMarker, lengthRemaining, ",,");
-        }
+        loc_eng_nmea_put_dop(writer, loc_eng_data_p, locationExtended);
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return;
 
         // ------------------
         // ------$GNGSA------
@@ -223,8 +328,6 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         uint32_t gloUsedList[32] = {0};
 
         // Reset locals for GNGSA sentence generation
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
         mask = loc_eng_data_p->glo_used_mask;
         fixType = '\0';
 
@@ -258,63 +361,30 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         // h.h : Horizontal DOP
         // v.v : Vertical DOP
         // cc : Checksum value
-        length = snprintf(pMarker, lengthRemaining, "$GNGSA,A,%c,", fixType);
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        writer.begin("GNGSA,A,");
+        writer.putChar(fixType);
+        writer.putChar(',');
 
         // Add first 12 GLONASS satellite IDs
         for (uint8_t i = 0; i < 12; i++)
         {
             if (i < gloUsedCount)
-                length = snprintf(pMarker, lengthRemaining, "%02d,", gloUsedList[i]);
-            else
-                length = snprintf(pMarker, lengthRemaining, ",");
-
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
+                writer.putInt(gloUsedList[i], 2);
+            writer.putChar(',');
         }
 
         // Add the position/horizontal/vertical DOP values
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
-        {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              locationExtended.pdop,
-                              locationExtended.hdop,
-                              locationExtended.vdop);
-        }
-        else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
-        {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              loc_eng_data_p->pdop,
-                              loc_eng_data_p->hdop,
-                              loc_eng_data_p->vdop);
-        }
-        else
-        {   // no dop
-            length = snprintf(pMarker, lengthRemaining, ",,");
-        }
+        loc_eng_nmea_put_dop(writer, loc_eng_data_p, locationExtended);
 
         /* Sentence is ready, add checksum and broadcast */
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return;
 
         // ------------------
         // ------$GPVTG------
         // ------------------
 
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
+        writer.begin("GPVTG,");
 
         if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
         {
@@ -328,163 +398,68 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
                     magTrack -= 360.0;
             }
 
-            length = snprintf(pMarker, lengthRemaining, "$GPVTG,%.1lf,T,%.1lf,M,", location.gpsLocation.bearing, magTrack);
+            writer.putFixed(location.gpsLocation.bearing, 1);
+            writer.putStr(",T,");
+            writer.putFixed(magTrack, 1);
+            writer.putStr(",M,");
         }
         else
         {
-            length = snprintf(pMarker, lengthRemaining, "$GPVTG,,T,,M,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
+            writer.putStr(",T,,M,");
         }
-        pMarker += length;
-        lengthRemaining -= length;
 
         if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
         {
             float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
             float speedKmPerHour = location.gpsLocation.speed * 3.6;
 
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,N,%.1lf,K,", speedKnots, speedKmPerHour);
+            writer.putFixed(speedKnots, 1);
+            writer.putStr(",N,");
+            writer.putFixed(speedKmPerHour, 1);
+            writer.putStr(",K,");
         }
         else
         {
-            length = snprintf(pMarker, lengthRemaining, ",N,,K,");
+            writer.putStr(",N,,K,");
         }
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
         if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
-            length = snprintf(pMarker, lengthRemaining, "%c", 'N'); // N means no fix
+            writer.putChar('N'); // N means no fix
         else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
-            length = snprintf(pMarker, lengthRemaining, "%c", 'A'); // A means autonomous
+            writer.putChar('A'); // A means autonomous
         else
-            length = snprintf(pMarker, lengthRemaining, "%c", 'D'); // D means differential
+            writer.putChar('D'); // D means differential
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return;
 
         // ------------------
         // ------$GPRMC------
         // ------------------
 
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
-
-        length = snprintf(pMarker, lengthRemaining, "$GPRMC,%02d%02d%02d.%02d,A," ,
-                          utcHours, utcMinutes, utcSeconds,utcMSeconds/10);
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
-        {
-            double latitude = location.gpsLocation.latitude;
-            double longitude = location.gpsLocation.longitude;
-            char latHemisphere;
-            char lonHemisphere;
-            double latMinutes;
-            double lonMinutes;
-
-            if (latitude > 0)
-            {
-                latHemisphere = 'N';
-            }
-            else
-            {
-                latHemisphere = 'S';
-                latitude *= -1.0;
-            }
-
-            if (longitude < 0)
-            {
-                lonHemisphere = 'W';
-                longitude *= -1.0;
-            }
-            else
-            {
-                lonHemisphere = 'E';
-            }
+        writer.begin("GPRMC,");
+        loc_eng_nmea_put_utc_time(writer, utcHours, utcMinutes, utcSeconds, utcMSeconds);
+        writer.putStr("A,");
 
-            latMinutes = fmod(latitude * 60.0 , 60.0);
-            lonMinutes = fmod(longitude * 60.0 , 60.0);
-
-            length = snprintf(pMarker, lengthRemaining, "%02d%09.6lf,%c,%03d%09.6lf,%c,",
-                              (uint8_t)floor(latitude), latMinutes, latHemisphere,
-                              (uint8_t)floor(longitude),lonMinutes, lonHemisphere);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,,,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        loc_eng_nmea_put_lat_long(writer, location);
 
         if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
         {
             float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,", speedKnots);
+            writer.putFixed(speedKnots, 1);
         }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        writer.putChar(',');
 
         if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
         {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,", location.gpsLocation.bearing);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
+            writer.putFixed(location.gpsLocation.bearing, 1);
         }
-        pMarker += length;
-        lengthRemaining -= length;
+        writer.putChar(',');
 
-        length = snprintf(pMarker, lengthRemaining, "%2.2d%2.2d%2.2d,",
-                          utcDay, utcMonth, utcYear);
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        writer.putInt(utcDay, 2);
+        writer.putInt(utcMonth, 2);
+        writer.putInt(utcYear, 2);
+        writer.putChar(',');
 
         if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_MAG_DEV)
         {
@@ -500,98 +475,34 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
                 direction = 'E';
             }
 
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,%c,",
-                              magneticVariation, direction);
+            writer.putFixed(magneticVariation, 1);
+            writer.putChar(',');
+            writer.putChar(direction);
+            writer.putChar(',');
         }
         else
         {
-            length = snprintf(pMarker, lengthRemaining, ",,");
+            writer.putStr(",,");
         }
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
         if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
-            length = snprintf(pMarker, lengthRemaining, "%c", 'N'); // N means no fix
+            writer.putChar('N'); // N means no fix
         else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
-            length = snprintf(pMarker, lengthRemaining, "%c", 'A'); // A means autonomous
+            writer.putChar('A'); // A means autonomous
         else
-            length = snprintf(pMarker, lengthRemaining, "%c", 'D'); // D means differential
+            writer.putChar('D'); // D means differential
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return;
 
         // ------------------
         // ------$GPGGA------
         // ------------------
 
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
+        writer.begin("GPGGA,");
+        loc_eng_nmea_put_utc_time(writer, utcHours, utcMinutes, utcSeconds, utcMSeconds);
 
-        length = snprintf(pMarker, lengthRemaining, "$GPGGA,%02d%02d%02d.%02d," ,
-                          utcHours, utcMinutes, utcSeconds, utcMSeconds/10);
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
-        {
-            double latitude = location.gpsLocation.latitude;
-            double longitude = location.gpsLocation.longitude;
-            char latHemisphere;
-            char lonHemisphere;
-            double latMinutes;
-            double lonMinutes;
-
-            if (latitude > 0)
-            {
-                latHemisphere = 'N';
-            }
-            else
-            {
-                latHemisphere = 'S';
-                latitude *= -1.0;
-            }
-
-            if (longitude < 0)
-            {
-                lonHemisphere = 'W';
-                longitude *= -1.0;
-            }
-            else
-            {
-                lonHemisphere = 'E';
-            }
-
-            latMinutes = fmod(latitude * 60.0 , 60.0);
-            lonMinutes = fmod(longitude * 60.0 , 60.0);
-
-            length = snprintf(pMarker, lengthRemaining, "%02d%09.6lf,%c,%03d%09.6lf,%c,",
-                              (uint8_t)floor(latitude), latMinutes, latHemisphere,
-                              (uint8_t)floor(longitude),lonMinutes, lonHemisphere);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,,,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+        loc_eng_nmea_put_lat_long(writer, location);
 
         char gpsQuality;
         if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
@@ -601,84 +512,63 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         else
             gpsQuality = '2'; // 2 means DGPS fix
 
+        writer.putChar(gpsQuality);
+        writer.putChar(',');
+        writer.putInt(svUsedCount, 2);
+        writer.putChar(',');
+
         if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
         {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,%.1f,",
-                              gpsQuality, svUsedCount, locationExtended.hdop);
+            writer.putFixed(locationExtended.hdop, 1);
         }
         else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
         {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,%.1f,",
-                              gpsQuality, svUsedCount, loc_eng_data_p->hdop);
-        }
-        else
-        {   // no hdop
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,,",
-                              gpsQuality, svUsedCount);
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
+            writer.putFixed(loc_eng_data_p->hdop, 1);
         }
-        pMarker += length;
-        lengthRemaining -= length;
+        // else no hdop
+        writer.putChar(',');
 
         if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL)
         {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,M,",
-                              locationExtended.altitudeMeanSeaLevel);
+            writer.putFixed(locationExtended.altitudeMeanSeaLevel, 1);
+            writer.putStr(",M,");
         }
         else
         {
-            length = snprintf(pMarker, lengthRemaining,",,");
+            writer.putStr(",,");
         }
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
         if ((location.gpsLocation.flags & GPS_LOCATION_HAS_ALTITUDE) &&
             (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL))
         {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,M,,",
-                              location.gpsLocation.altitude - locationExtended.altitudeMeanSeaLevel);
+            writer.putFixed(location.gpsLocation.altitude - locationExtended.altitudeMeanSeaLevel, 1);
+            writer.putStr(",M,,");
         }
         else
         {
-            length = snprintf(pMarker, lengthRemaining,",,,");
+            writer.putStr(",,,");
         }
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return;
 
     }
     //Send blank NMEA reports for non-final fixes
     else {
-        strlcpy(sentence, "$GPGSA,A,1,,,,,,,,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        writer.begin("GPGSA,A,1,,,,,,,,,,,,,,,");
+        loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
 
-        strlcpy(sentence, "$GNGSA,A,1,,,,,,,,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        writer.begin("GNGSA,A,1,,,,,,,,,,,,,,,");
+        loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
 
-        strlcpy(sentence, "$GPVTG,,T,,M,,N,,K,N", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        writer.begin("GPVTG,,T,,M,,N,,K,N");
+        loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
 
-        strlcpy(sentence, "$GPRMC,,V,,,,,,,,,,N", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        writer.begin("GPRMC,,V,,,,,,,,,,N");
+        loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
 
-        strlcpy(sentence, "$GPGGA,,,,,,0,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        writer.begin("GPGGA,,,,,,0,,,,,,,,");
+        loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
     }
     // clear the dop cache so they can't be used again
     loc_eng_data_p->pdop = 0;
@@ -690,6 +580,83 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
 
 
 
+/*===========================================================================
+FUNCTION    loc_eng_nmea_generate_gsv
+
+DESCRIPTION
+   Generate the $--GSV sentences for the SVs of one constellation
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   false if a sentence could not be formatted, true otherwise
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static bool loc_eng_nmea_generate_gsv(loc_eng_data_s_type *loc_eng_data_p,
+                                      int64_t now,
+                                      const GnssSvStatus &svStatus,
+                                      GnssConstellationType constellation,
+                                      const char *id, int count)
+{
+    char sentence[NMEA_SENTENCE_MAX_LENGTH] = {0};
+    LocEngNmeaWriter writer(sentence, sizeof(sentence));
+    int svCount = svStatus.num_svs;
+
+    if (count <= 0)
+    {
+        // no svs in view, so just send a blank sentence
+        writer.begin(id);
+        writer.putStr("1,1,0,");
+        return loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p);
+    }
+
+    int svNumber = 1;
+    int sentenceNumber = 1;
+    int sentenceCount = count/4 + (count % 4 != 0);
+
+    while (sentenceNumber <= sentenceCount)
+    {
+        writer.begin(id);
+        writer.putInt(sentenceCount, 0);
+        writer.putChar(',');
+        writer.putInt(sentenceNumber, 0);
+        writer.putChar(',');
+        writer.putInt(count, 2);
+
+        for (int i=0; (svNumber <= svCount) && (i < 4);  svNumber++)
+        {
+            const GnssSvInfo &sv = svStatus.gnss_sv_list[svNumber - 1];
+            if (constellation == sv.constellation)
+            {
+                writer.putChar(',');
+                writer.putInt(sv.svid, 2);
+                writer.putChar(',');
+                writer.putInt((int)(0.5 + sv.elevation), 2); //float to int
+                writer.putChar(',');
+                writer.putInt((int)(0.5 + sv.azimuth), 3); //float to int
+                writer.putChar(',');
+
+                if (sv.c_n0_dbhz > 0)
+                {
+                    writer.putInt((int)(0.5 + sv.c_n0_dbhz), 2); //float to int
+                }
+
+                i++;
+            }
+        }
+
+        if (!loc_eng_nmea_finish(writer, sentence, now, loc_eng_data_p))
+            return false;
+        sentenceNumber++;
+    }
+
+    return true;
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_nmea_generate_sv
 
@@ -711,13 +678,8 @@ void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
 {
     ENTRY_LOG();
 
-    char sentence[NMEA_SENTENCE_MAX_LENGTH] = {0};
-    char* pMarker = sentence;
-    int lengthRemaining = sizeof(sentence);
-    int length = 0;
+    int64_t now = loc_eng_nmea_now();
     int svCount = svStatus.num_svs;
-    int sentenceCount = 0;
-    int sentenceNumber = 1;
     int svNumber = 1;
     int gpsCount = 0;
     int glnCount = 0;
@@ -753,156 +715,17 @@ void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
     // ------$GPGSV------
     // ------------------
 
-    if (gpsCount <= 0)
-    {
-        // no svs in view, so just send a blank $GPGSV sentence
-        strlcpy(sentence, "$GPGSV,1,1,0,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-    }
-    else
-    {
-        svNumber = 1;
-        sentenceNumber = 1;
-        sentenceCount = gpsCount/4 + (gpsCount % 4 != 0);
-
-        while (sentenceNumber <= sentenceCount)
-        {
-            pMarker = sentence;
-            lengthRemaining = sizeof(sentence);
-
-            length = snprintf(pMarker, lengthRemaining, "$GPGSV,%d,%d,%02d",
-                          sentenceCount, sentenceNumber, gpsCount);
-
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
-
-            for (int i=0; (svNumber <= svCount) && (i < 4);  svNumber++)
-            {
-                if (GNSS_CONSTELLATION_GPS == svStatus.gnss_sv_list[svNumber - 1].constellation)
-                {
-                    length = snprintf(pMarker, lengthRemaining,",%02d,%02d,%03d,",
-                                      svStatus.gnss_sv_list[svNumber-1].svid,
-                                      (int)(0.5 + svStatus.gnss_sv_list[svNumber-1].elevation), //float to int
-                                      (int)(0.5 + svStatus.gnss_sv_list[svNumber-1].azimuth)); //float to int
-
-                    if (length < 0 || length >= lengthRemaining)
-                    {
-                        LOC_LOGE("NMEA Error in string formatting");
-                        return;
-                    }
-                    pMarker += length;
-                    lengthRemaining -= length;
-
-                    if (svStatus.gnss_sv_list[svNumber-1].c_n0_dbhz > 0)
-                    {
-                        length = snprintf(pMarker, lengthRemaining,"%02d",
-                                         (int)(0.5 + svStatus.gnss_sv_list[svNumber-1].c_n0_dbhz)); //float to int
-
-                        if (length < 0 || length >= lengthRemaining)
-                        {
-                            LOC_LOGE("NMEA Error in string formatting");
-                            return;
-                        }
-                        pMarker += length;
-                        lengthRemaining -= length;
-                    }
-
-                    i++;
-               }
-
-            }
-
-            length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-            sentenceNumber++;
-
-        }  //while
-
-    } //if
+    if (!loc_eng_nmea_generate_gsv(loc_eng_data_p, now, svStatus,
+                                   GNSS_CONSTELLATION_GPS, "GPGSV,", gpsCount))
+        return;
 
     // ------------------
     // ------$GLGSV------
     // ------------------
 
-    if (glnCount <= 0)
-    {
-        // no svs in view, so just send a blank $GLGSV sentence
-        strlcpy(sentence, "$GLGSV,1,1,0,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-    }
-    else
-    {
-        svNumber = 1;
-        sentenceNumber = 1;
-        sentenceCount = glnCount/4 + (glnCount % 4 != 0);
-
-        while (sentenceNumber <= sentenceCount)
-        {
-            pMarker = sentence;
-            lengthRemaining = sizeof(sentence);
-
-            length = snprintf(pMarker, lengthRemaining, "$GLGSV,%d,%d,%02d",
-                          sentenceCount, sentenceNumber, glnCount);
-
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
-
-            for (int i=0; (svNumber <= svCount) && (i < 4);  svNumber++)
-            {
-                if (GNSS_CONSTELLATION_GLONASS == svStatus.gnss_sv_list[svNumber - 1].constellation)
-                {
-
-                    length = snprintf(pMarker, lengthRemaining,",%02d,%02d,%03d,",
-                        svStatus.gnss_sv_list[svNumber - 1].svid,
-                        (int)(0.5 + svStatus.gnss_sv_list[svNumber - 1].elevation), //float to int
-                        (int)(0.5 + svStatus.gnss_sv_list[svNumber - 1].azimuth)); //float to int
-
-                    if (length < 0 || length >= lengthRemaining)
-                    {
-                        LOC_LOGE("NMEA Error in string formatting");
-                        return;
-                    }
-                    pMarker += length;
-                    lengthRemaining -= length;
-
-                    if (svStatus.gnss_sv_list[svNumber - 1].c_n0_dbhz > 0)
-                    {
-                        length = snprintf(pMarker, lengthRemaining,"%02d",
-                            (int)(0.5 + svStatus.gnss_sv_list[svNumber - 1].c_n0_dbhz)); //float to int
-
-                        if (length < 0 || length >= lengthRemaining)
-                        {
-                            LOC_LOGE("NMEA Error in string formatting");
-                            return;
-                        }
-                        pMarker += length;
-                        lengthRemaining -= length;
-                    }
-
-                    i++;
-               }
-
-            }
-
-            length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-            sentenceNumber++;
-
-        }  //while
-
-    }//if
+    if (!loc_eng_nmea_generate_gsv(loc_eng_data_p, now, svStatus,
+                                   GNSS_CONSTELLATION_GLONASS, "GLGSV,", glnCount))
+        return;
 
     // For RPC, the DOP are sent during sv report, so cache them
     // now to be sent during position report.
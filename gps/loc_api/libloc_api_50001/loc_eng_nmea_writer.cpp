@@ -0,0 +1,377 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <loc_eng_nmea_writer.h>
+#include <stdio.h>
+#include <math.h>
+
+static const uint32_t sPow10[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000
+};
+
+#define NMEA_WRITER_MAX_PRECISION  6
+// below this every double has a negative binary exponent once its 53 bit
+// mantissa is made an integer, and value * 10^6 stays under 2^50
+#define NMEA_WRITER_EXACT_LIMIT    1e9
+
+// Rounds |value| * 10^precision to the nearest integer the way printf does,
+// i.e. on the exact binary value with ties going to even. The mantissa is
+// taken out as a 53 bit integer m and an exponent e (< 0 in our range),
+// so the scaled value is m * 10^precision / 2^-e. The product needs up to
+// 73 bits, hence the hi:lo pair.
+static uint64_t scaleAndRound(double value, int precision)
+{
+    int exp = 0;
+    double frac = frexp(fabs(value), &exp);
+    if (0.0 == frac) {
+        return 0;
+    }
+    uint64_t m = (uint64_t)ldexp(frac, 53);
+    int shift = 53 - exp;
+
+    uint64_t p = sPow10[precision];
+    uint64_t a = (m & 0xFFFFFFFFULL) * p;
+    uint64_t b = (m >> 32) * p;
+    uint64_t lo = a + (b << 32);
+    uint64_t hi = (b >> 32) + (lo < a ? 1 : 0);
+
+    // product < 2^73, so anything shifted further down is below one half
+    if (shift > 73) {
+        return 0;
+    }
+
+    // |value| < 1e9 < 2^30 keeps shift at 23 or more
+    uint64_t q, remHi, remLo, halfHi, halfLo;
+    if (shift < 64) {
+        q = (lo >> shift) | (hi << (64 - shift));
+        remHi = 0;
+        remLo = lo & ((1ULL << shift) - 1);
+        halfHi = 0;
+        halfLo = 1ULL << (shift - 1);
+    } else {
+        int s = shift - 64;
+        q = hi >> s;
+        remHi = hi & ((1ULL << s) - 1);
+        remLo = lo;
+        halfHi = s ? (1ULL << (s - 1)) : 0;
+        halfLo = s ? 0 : (1ULL << 63);
+    }
+
+    if (remHi > halfHi ||
+        (remHi == halfHi && (remLo > halfLo ||
+                             (remLo == halfLo && (q & 1))))) {
+        q++;
+    }
+    return q;
+}
+
+LocEngNmeaWriter::LocEngNmeaWriter(char* buf, int size) :
+    mBuf(buf), mSize(size), mLen(0), mChecksum(0), mOverflow(size <= 0)
+{
+    if (!mOverflow) {
+        mBuf[0] = '\0';
+    }
+}
+
+void LocEngNmeaWriter::putRaw(char c)
+{
+    if (mLen + 1 < mSize) {
+        mBuf[mLen++] = c;
+        mBuf[mLen] = '\0';
+    } else {
+        mOverflow = true;
+    }
+}
+
+void LocEngNmeaWriter::begin(const char* id)
+{
+    mLen = 0;
+    mChecksum = 0;
+    mOverflow = (mSize <= 0);
+    putRaw('$');
+    putStr(id);
+}
+
+void LocEngNmeaWriter::putChar(char c)
+{
+    putRaw(c);
+    mChecksum ^= (uint8_t)c;
+}
+
+void LocEngNmeaWriter::putStr(const char* str)
+{
+    while ('\0' != *str) {
+        putChar(*str++);
+    }
+}
+
+void LocEngNmeaWriter::putDigits(uint64_t value, int minDigits)
+{
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (char)(value % 10);
+        value /= 10;
+    } while (0 != value && n < (int)sizeof(digits));
+    while (n < minDigits && n < (int)sizeof(digits)) {
+        digits[n++] = '0';
+    }
+    while (n > 0) {
+        putChar(digits[--n]);
+    }
+}
+
+void LocEngNmeaWriter::putInt(int value, int width)
+{
+    if (value < 0) {
+        putChar('-');
+        putDigits((uint64_t)(-(int64_t)value), width - 1);
+    } else {
+        putDigits((uint64_t)value, width);
+    }
+}
+
+void LocEngNmeaWriter::putFixed(double value, int precision, int width)
+{
+    if (precision < 0 || precision > NMEA_WRITER_MAX_PRECISION ||
+        !(fabs(value) < NMEA_WRITER_EXACT_LIMIT)) {
+        char tmp[64];
+        snprintf(tmp, sizeof(tmp), "%0*.*f", width, precision, value);
+        putStr(tmp);
+        return;
+    }
+
+    uint64_t scaled = scaleAndRound(value, precision);
+    uint64_t intPart = scaled / sPow10[precision];
+    uint64_t fracPart = scaled % sPow10[precision];
+    bool negative = signbit(value);
+
+    int intDigits = 1;
+    for (uint64_t v = intPart; v >= 10; v /= 10) {
+        intDigits++;
+    }
+    int length = (negative ? 1 : 0) + intDigits +
+                 (precision > 0 ? precision + 1 : 0);
+
+    if (negative) {
+        putChar('-');
+    }
+    putDigits(intPart, intDigits + (width > length ? width - length : 0));
+    if (precision > 0) {
+        putChar('.');
+        putDigits(fracPart, precision);
+    }
+}
+
+int LocEngNmeaWriter::finish()
+{
+    static const char hex[] = "0123456789ABCDEF";
+    putRaw('*');
+    putRaw(hex[mChecksum >> 4]);
+    putRaw(hex[mChecksum & 0xF]);
+    putRaw('\r');
+    putRaw('\n');
+    return mOverflow ? -1 : mLen;
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// reference: the snprintf + loc_eng_nmea_put_checksum path being replaced
+static int refChecksum(char* pNmea, int maxSize)
+{
+    uint8_t checksum = 0;
+    int length = 0;
+    pNmea++;
+    while (*pNmea != '\0') {
+        checksum ^= *pNmea++;
+        length++;
+    }
+    return length + snprintf(pNmea, maxSize - length - 1, "*%02X\r\n", checksum) + 1;
+}
+
+static int sFailures = 0;
+
+static void expect(const char* what, const char* got, const char* want)
+{
+    if (0 != strcmp(got, want)) {
+        printf("FAIL %s: got \"%s\" want \"%s\"\n", what, got, want);
+        sFailures++;
+    }
+}
+
+static void checkFixed(double v, int precision, int width)
+{
+    char want[64];
+    char got[64];
+    snprintf(want, sizeof(want), "%0*.*f", width, precision, v);
+    LocEngNmeaWriter w(got, sizeof(got));
+    w.putFixed(v, precision, width);
+    expect("putFixed", got, want);
+}
+
+static void checkInt(int v, int width)
+{
+    char want[32];
+    char got[32];
+    snprintf(want, sizeof(want), "%0*d", width, v);
+    LocEngNmeaWriter w(got, sizeof(got));
+    w.putInt(v, width);
+    expect("putInt", got, want);
+}
+
+// the position part of $GPRMC, both ways
+static int refRmc(char* buf, int size, double lat, double lon, float speed, float bearing)
+{
+    char latH = lat > 0 ? 'N' : 'S';
+    char lonH = lon < 0 ? 'W' : 'E';
+    if (lat <= 0) lat *= -1.0;
+    if (lon < 0) lon *= -1.0;
+    int n = snprintf(buf, size, "$GPRMC,%02d%02d%02d.%02d,A,", 12, 34, 56, 78);
+    n += snprintf(buf + n, size - n, "%02d%09.6lf,%c,%03d%09.6lf,%c,",
+                  (uint8_t)floor(lat), fmod(lat * 60.0, 60.0), latH,
+                  (uint8_t)floor(lon), fmod(lon * 60.0, 60.0), lonH);
+    n += snprintf(buf + n, size - n, "%.1lf,", speed * (3600.0/1852.0));
+    n += snprintf(buf + n, size - n, "%.1lf,", bearing);
+    n += snprintf(buf + n, size - n, "%2.2d%2.2d%2.2d,", 19, 10, 26);
+    n += snprintf(buf + n, size - n, ",,");
+    snprintf(buf + n, size - n, "%c", 'A');
+    return refChecksum(buf, size);
+}
+
+static int writerRmc(char* buf, int size, double lat, double lon, float speed, float bearing)
+{
+    char latH = lat > 0 ? 'N' : 'S';
+    char lonH = lon < 0 ? 'W' : 'E';
+    if (lat <= 0) lat *= -1.0;
+    if (lon < 0) lon *= -1.0;
+    LocEngNmeaWriter w(buf, size);
+    w.begin("GPRMC,");
+    w.putInt(12, 2); w.putInt(34, 2); w.putInt(56, 2);
+    w.putChar('.'); w.putInt(78, 2); w.putStr(",A,");
+    w.putInt((uint8_t)floor(lat), 2); w.putFixed(fmod(lat * 60.0, 60.0), 6, 9);
+    w.putChar(','); w.putChar(latH); w.putChar(',');
+    w.putInt((uint8_t)floor(lon), 3); w.putFixed(fmod(lon * 60.0, 60.0), 6, 9);
+    w.putChar(','); w.putChar(lonH); w.putChar(',');
+    w.putFixed(speed * (3600.0/1852.0), 1); w.putChar(',');
+    w.putFixed(bearing, 1); w.putChar(',');
+    w.putInt(19, 2); w.putInt(10, 2); w.putInt(26, 2); w.putStr(",,,");
+    w.putChar('A');
+    return w.finish();
+}
+
+static double randomIn(double lo, double hi)
+{
+    return lo + (hi - lo) * ((double)rand() / RAND_MAX);
+}
+
+static double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_DEBUG__ -O2 -I. loc_eng_nmea_writer.cpp
+// test: ./a.out [iterations]
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000000;
+    char want[200];
+    char got[200];
+    srand(time(NULL));
+
+    // golden sentences
+    LocEngNmeaWriter w(got, sizeof(got));
+    w.begin("GPGSA,A,1,,,,,,,,,,,,,,,");
+    w.finish();
+    expect("GPGSA", got, "$GPGSA,A,1,,,,,,,,,,,,,,,*1E\r\n");
+    w.begin("GPGGA,,,,,,0,,,,,,,,");
+    w.finish();
+    expect("GPGGA", got, "$GPGGA,,,,,,0,,,,,,,,*66\r\n");
+    writerRmc(got, sizeof(got), 37.4219983, -122.084, 1.5f, 271.25f);
+    expect("GPRMC", got, "$GPRMC,123456.78,A,3725.319898,N,12205.040000,W,2.9,271.2,191026,,,A*45\r\n");
+
+    // edge values for the rounding
+    const double edges[] = { 0.0, -0.0, 0.05, 0.15, 0.25, 0.35, 0.45, -0.04, -0.05,
+                             0.95, 9.95, 99.95, 1e-300, 59.9999995, 59.99999949,
+                             123456789.95, 999999999.0, 1e9, 1e20, -1e20,
+                             INFINITY, -INFINITY, NAN };
+    for (size_t i = 0; i < sizeof(edges) / sizeof(edges[0]); i++) {
+        for (int p = 0; p <= 7; p++) {
+            checkFixed(edges[i], p, 0);
+            checkFixed(edges[i], p, 9);
+        }
+    }
+    const int ints[] = { 0, 1, 9, 10, 99, 100, 359, -1, -4, -10, 2147483647, -2147483647 - 1 };
+    for (size_t i = 0; i < sizeof(ints) / sizeof(ints[0]); i++) {
+        for (int width = 0; width <= 3; width++) {
+            checkInt(ints[i], width);
+        }
+    }
+
+    // random sentences against the snprintf path
+    for (int i = 0; i < iterations && sFailures < 10; i++) {
+        double lat = randomIn(-90.0, 90.0);
+        double lon = randomIn(-180.0, 180.0);
+        float speed = (float)randomIn(0.0, 100.0);
+        float bearing = (float)randomIn(0.0, 360.0);
+        int wantLen = refRmc(want, sizeof(want), lat, lon, speed, bearing);
+        int gotLen = writerRmc(got, sizeof(got), lat, lon, speed, bearing);
+        expect("random GPRMC", got, want);
+        if (wantLen != gotLen) {
+            printf("FAIL length %d != %d\n", gotLen, wantLen);
+            sFailures++;
+        }
+        checkFixed(randomIn(-1000.0, 1000.0), 1, 0);
+    }
+
+    // throughput
+    volatile int sink = 0;
+    double start = nowSec();
+    for (int i = 0; i < iterations; i++) {
+        sink += refRmc(want, sizeof(want), 37.4219983 + i * 1e-7, -122.084, 1.5f, 271.25f);
+    }
+    double refSec = nowSec() - start;
+    start = nowSec();
+    for (int i = 0; i < iterations; i++) {
+        sink += writerRmc(got, sizeof(got), 37.4219983 + i * 1e-7, -122.084, 1.5f, 271.25f);
+    }
+    double writerSec = nowSec() - start;
+    printf("GPRMC x %d: snprintf %.1f ns/sentence, writer %.1f ns/sentence\n",
+           iterations, refSec * 1e9 / iterations, writerSec * 1e9 / iterations);
+
+    printf("%s\n", sFailures ? "FAILED" : "PASSED");
+    return sFailures ? 1 : 0;
+}
+
+#endif
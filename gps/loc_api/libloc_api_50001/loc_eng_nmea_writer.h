@@ -0,0 +1,75 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LOC_ENG_NMEA_WRITER_H
+#define LOC_ENG_NMEA_WRITER_H
+
+#include <stdint.h>
+
+// Builds one NMEA sentence in a caller supplied buffer. Fields are
+// emitted with integer digit generation instead of snprintf, and the
+// checksum is accumulated as the characters are written, so finish()
+// does not need to walk the sentence again. The output is byte for
+// byte what the equivalent printf conversions would have produced.
+class LocEngNmeaWriter {
+    char* const mBuf;
+    const int mSize;
+    int mLen;
+    uint8_t mChecksum;
+    bool mOverflow;
+
+    // writes without touching the checksum; used for '$' and the trailer
+    void putRaw(char c);
+    void putDigits(uint64_t value, int minDigits);
+public:
+    LocEngNmeaWriter(char* buf, int size);
+
+    // starts over, writing the leading '$' followed by the sentence id,
+    // e.g. begin("GPGGA") gives "$GPGGA".
+    void begin(const char* id);
+
+    void putChar(char c);
+    void putStr(const char* str);
+
+    // same as "%0<width>d"; the sign, if any, counts towards the width
+    void putInt(int value, int width);
+
+    // same as "%0<width>.<precision>f"; width 0 means no padding.
+    // Values outside of what is rounded exactly here (|value| >= 1e9,
+    // inf, nan, precision > 6) fall back to snprintf.
+    void putFixed(double value, int precision, int width = 0);
+
+    // appends "*hh\r\n" and returns the total sentence length, or -1 if
+    // the sentence did not fit in the buffer.
+    int finish();
+
+    inline int length() const { return mLen; }
+    inline bool overflowed() const { return mOverflow; }
+};
+
+#endif // LOC_ENG_NMEA_WRITER_H
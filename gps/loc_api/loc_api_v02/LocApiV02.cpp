@@ -80,6 +80,9 @@ using namespace loc_core;
 /* number of QMI_LOC messages that need to be checked*/
 #define NUMBER_OF_MSG_TO_BE_CHECKED        (3)
 
+/* minimum interval between repeats of a per epoch warning */
+#define EPOCH_LOG_INTERVAL_MS   (5000)
+
 /* Gaussian 2D scaling table - scale from x% to 68% confidence */
 struct conf_scaler_to_68_pair {
     uint8_t confidence;
@@ -2116,7 +2119,8 @@ void LocApiV02 :: reportPosition (
     else
     {
        locationExtended.timeStamp.apTimeStampUncertaintyMs = FLT_MAX;
-       LOC_LOGE("%s:%d Error in clock_gettime() ",__func__, __LINE__);
+       LOC_LOGE_RL(EPOCH_LOG_INTERVAL_MS, "%s:%d Error in clock_gettime() ",
+                   __func__, __LINE__);
     }
     LOC_LOGD("%s:%d QMI_PosPacketTime  %ld (sec)  %ld (nsec)", __func__, __LINE__,
                  locationExtended.timeStamp.apTimeStamp.tv_sec,
@@ -2491,7 +2495,8 @@ void  LocApiV02 :: reportSvMeasurement (
   else
   {
     svMeasurementSet.timeStamp.apTimeStampUncertaintyMs = FLT_MAX;
-    LOC_LOGE("%s:%d Error in clock_gettime() ",__func__, __LINE__);
+    LOC_LOGE_RL(EPOCH_LOG_INTERVAL_MS, "%s:%d Error in clock_gettime() ",
+                __func__, __LINE__);
   }
   LOC_LOGD("%s:%d QMI_MeasPacketTime  %ld (sec)  %ld (nsec)",__func__,__LINE__,
             svMeasurementSet.timeStamp.apTimeStamp.tv_sec,
@@ -2770,8 +2775,9 @@ void  LocApiV02 :: reportSvMeasurement (
 
     if(gnss_raw_measurement_ptr->svMeasurement_len != cnt)
     {
-      LOC_LOGW("[SV_MEAS_QMI] #of SV in QMI: %d, Valid SV-id Count: %d",
-                 gnss_raw_measurement_ptr->svMeasurement_len,cnt );
+      LOC_LOGW_RL(EPOCH_LOG_INTERVAL_MS,
+                  "[SV_MEAS_QMI] #of SV in QMI: %d, Valid SV-id Count: %d",
+                  gnss_raw_measurement_ptr->svMeasurement_len,cnt );
     }
 
   } //if svClockMeasurement_valid
@@ -3325,18 +3331,16 @@ void LocApiV02 :: reportGnssMeasurementData(
     LOC_LOGV ("%s:%d]: entering\n", __func__, __LINE__);
 
     GnssData gnssMeasurementData;
-    memset (&gnssMeasurementData, 0, sizeof(GnssData));
 
     int svMeasurment_len = 0;
 
-    // size
-    gnssMeasurementData.size = sizeof(GnssData);
-
     // number of measurements
     if (gnss_measurement_report_ptr.svMeasurement_valid) {
         svMeasurment_len =
             gnss_measurement_report_ptr.svMeasurement_len;
-        gnssMeasurementData.measurement_count = svMeasurment_len;
+        if (svMeasurment_len > GNSS_MAX_MEASUREMENT) {
+            svMeasurment_len = GNSS_MAX_MEASUREMENT;
+        }
         LOC_LOGV ("%s:%d]: there are %d SV measurements\n",
                   __func__, __LINE__, svMeasurment_len);
     } else {
@@ -3347,6 +3351,20 @@ void LocApiV02 :: reportGnssMeasurementData(
     if (svMeasurment_len != 0 &&
         gnss_measurement_report_ptr.system == eQMI_LOC_SV_SYSTEM_GPS_V02) {
 
+        // only the header, the measurements in use and the clock are
+        // read downstream; the rest of the measurement array is left
+        // as is rather than cleared on every report
+        memset(&gnssMeasurementData, 0,
+               offsetof(GnssData, measurements));
+        memset(gnssMeasurementData.measurements, 0,
+               svMeasurment_len * sizeof(gnssMeasurementData.measurements[0]));
+        memset(&gnssMeasurementData.clock, 0,
+               sizeof(gnssMeasurementData.clock));
+
+        // size
+        gnssMeasurementData.size = sizeof(GnssData);
+        gnssMeasurementData.measurement_count = svMeasurment_len;
+
         // the array of measurements
         int index = 0;
         while(svMeasurment_len > 0) {
@@ -32,6 +32,7 @@
 
 #include <stdbool.h>
 #include <inttypes.h>
+#include <pthread.h>
 
 #include "qmi_client.h"
 #include "qmi_idl_lib.h"
@@ -63,6 +64,12 @@
 #define LOC_CLIENT_MAX_OPEN_RETRIES (20)
 #define LOC_CLIENT_TIME_BETWEEN_OPEN_RETRIES (1)
 
+// indication decode buffer pool; classes grow by 4x from the smallest
+// size up to the largest indication in the tables below
+#define LOC_CLIENT_IND_POOL_MIN_CLASS_SIZE (256)
+#define LOC_CLIENT_IND_POOL_MAX_CLASSES (8)
+#define LOC_CLIENT_IND_POOL_BUFS_PER_CLASS (2)
+
 enum
 {
   //! Special value for selecting any available service
@@ -642,6 +649,28 @@ static const locClientRespIndTableStructT locClientRespIndTable[]= {
 /** whether indication is an event or a response */
 typedef enum { eventIndType =0, respIndType = 1 } locClientIndEnumT;
 
+/** one size class of the indication decode buffer pool */
+typedef struct
+{
+  size_t   bufSize;
+  void    *freeBufs[LOC_CLIENT_IND_POOL_BUFS_PER_CLASS];
+  uint32_t numFree;
+  uint32_t numInUse;
+  // most buffers of this class in use at the same time
+  uint32_t highWaterMark;
+}locClientIndPoolClassType;
+
+/** per client pool of indication decode buffers */
+typedef struct
+{
+  pthread_mutex_t           lock;
+  uint32_t                  numClasses;
+  locClientIndPoolClassType classes[LOC_CLIENT_IND_POOL_MAX_CLASSES];
+  // indications that had to be decoded into a malloc'ed buffer because
+  // their class was exhausted
+  uint32_t                  numFallbacks;
+}locClientIndPoolType;
+
 
 /** @struct locClientInternalState
  */
@@ -663,6 +692,9 @@ struct locClientCbDataStructT
   // the event mask the client has registered for
   locClientEventMaskType eventRegMask;
 
+  // buffers the indications are decoded into
+  locClientIndPoolType indPool;
+
   //pointer to itself for checking consistency data
    locClientCallbackDataType *pMe;
 };
@@ -711,6 +743,178 @@ static bool locClientGetSizeAndTypeByIndId (uint32_t indId, size_t *pIndSize,
   return false;
 }
 
+/** locClientIndPoolInit
+ *  @brief sets up the size classes of the indication buffer pool
+ *         from the largest event and response indication. Buffers
+ *         are allocated on first use and kept until the pool is
+ *         destroyed.
+ *  @param [in] pPool */
+
+static void locClientIndPoolInit(locClientIndPoolType *pPool)
+{
+  size_t maxSize = 0, idx = 0, classSize = 0;
+
+  for(idx = 0;
+      idx < sizeof(locClientEventIndTable)/sizeof(locClientEventIndTable[0]);
+      idx++)
+  {
+    if(locClientEventIndTable[idx].eventSize > maxSize)
+    {
+      maxSize = locClientEventIndTable[idx].eventSize;
+    }
+  }
+
+  for(idx = 0;
+      idx < sizeof(locClientRespIndTable)/sizeof(locClientRespIndTable[0]);
+      idx++)
+  {
+    if(locClientRespIndTable[idx].respIndSize > maxSize)
+    {
+      maxSize = locClientRespIndTable[idx].respIndSize;
+    }
+  }
+
+  memset(pPool, 0, sizeof(*pPool));
+  pthread_mutex_init(&pPool->lock, NULL);
+
+  classSize = LOC_CLIENT_IND_POOL_MIN_CLASS_SIZE;
+  while(pPool->numClasses < LOC_CLIENT_IND_POOL_MAX_CLASSES)
+  {
+    // the last class is exactly as big as the largest indication
+    if(classSize >= maxSize ||
+       pPool->numClasses == LOC_CLIENT_IND_POOL_MAX_CLASSES - 1)
+    {
+      pPool->classes[pPool->numClasses++].bufSize = maxSize;
+      break;
+    }
+    pPool->classes[pPool->numClasses++].bufSize = classSize;
+    classSize *= 4;
+  }
+
+  LOC_LOGV("%s:%d]: %d classes, largest indication %d bytes\n",
+           __func__, __LINE__, pPool->numClasses, (uint32_t)maxSize);
+}
+
+/** locClientIndPoolDestroy
+ *  @brief frees the pooled buffers and logs the pool statistics;
+ *         must only be called once no indication can be in flight
+ *  @param [in] pPool */
+
+static void locClientIndPoolDestroy(locClientIndPoolType *pPool)
+{
+  uint32_t i = 0, j = 0;
+
+  for(i = 0; i < pPool->numClasses; i++)
+  {
+    locClientIndPoolClassType *pClass = &pPool->classes[i];
+
+    LOC_LOGD("%s:%d]: class %d bytes: high water mark %d\n",
+             __func__, __LINE__, (uint32_t)pClass->bufSize,
+             pClass->highWaterMark);
+
+    for(j = 0; j < pClass->numFree; j++)
+    {
+      free(pClass->freeBufs[j]);
+    }
+  }
+
+  LOC_LOGD("%s:%d]: %d fallback allocations\n",
+           __func__, __LINE__, pPool->numFallbacks);
+
+  pthread_mutex_destroy(&pPool->lock);
+  memset(pPool, 0, sizeof(*pPool));
+}
+
+/** locClientIndPoolGet
+ *  @brief gets a buffer of at least indSize bytes from the
+ *         smallest class that fits, falling back to malloc when
+ *         that class has no buffer left
+ *  @param [in]  pPool
+ *  @param [in]  indSize
+ *  @param [out] pClassIdx class to return the buffer to, -1 if
+ *               the buffer was not taken from the pool
+ *  @return the buffer, NULL if out of memory */
+
+static void* locClientIndPoolGet(locClientIndPoolType *pPool,
+                                 size_t indSize, int *pClassIdx)
+{
+  void *pBuf = NULL;
+  uint32_t i = 0;
+
+  *pClassIdx = -1;
+
+  pthread_mutex_lock(&pPool->lock);
+
+  for(i = 0; i < pPool->numClasses; i++)
+  {
+    locClientIndPoolClassType *pClass = &pPool->classes[i];
+
+    if(pClass->bufSize < indSize)
+    {
+      continue;
+    }
+
+    if(pClass->numFree > 0)
+    {
+      pBuf = pClass->freeBufs[--pClass->numFree];
+    }
+    else if(pClass->numInUse < LOC_CLIENT_IND_POOL_BUFS_PER_CLASS)
+    {
+      pBuf = malloc(pClass->bufSize);
+    }
+
+    if(NULL != pBuf)
+    {
+      *pClassIdx = (int)i;
+      if(++pClass->numInUse > pClass->highWaterMark)
+      {
+        pClass->highWaterMark = pClass->numInUse;
+      }
+    }
+    break;
+  }
+
+  if(NULL == pBuf)
+  {
+    pPool->numFallbacks++;
+  }
+
+  pthread_mutex_unlock(&pPool->lock);
+
+  if(NULL == pBuf)
+  {
+    pBuf = malloc(indSize);
+  }
+
+  return pBuf;
+}
+
+/** locClientIndPoolPut
+ *  @brief returns a buffer obtained from locClientIndPoolGet
+ *  @param [in] pPool
+ *  @param [in] pBuf
+ *  @param [in] classIdx as returned by locClientIndPoolGet */
+
+static void locClientIndPoolPut(locClientIndPoolType *pPool,
+                                void *pBuf, int classIdx)
+{
+  locClientIndPoolClassType *pClass = NULL;
+
+  if(classIdx < 0)
+  {
+    free(pBuf);
+    return;
+  }
+
+  pthread_mutex_lock(&pPool->lock);
+
+  pClass = &pPool->classes[classIdx];
+  pClass->numInUse--;
+  pClass->freeBufs[pClass->numFree++] = pBuf;
+
+  pthread_mutex_unlock(&pPool->lock);
+}
+
 /** checkQmiMsgsSupported
  @brief check the qmi service is supported or not.
  @param [in] pResponse  pointer to the response received from
@@ -931,9 +1135,11 @@ static void locClientIndCb
   if( true == locClientGetSizeAndTypeByIndId(msg_id, &indSize, &indType))
   {
     void *indBuffer = NULL;
+    int indPoolClass = -1;
 
     // decode the indication
-    indBuffer = malloc(indSize);
+    indBuffer = locClientIndPoolGet(&pCallbackData->indPool, indSize,
+                                    &indPoolClass);
 
     if(NULL == indBuffer)
     {
@@ -1025,7 +1231,7 @@ static void locClientIndCb
     }
     if(indBuffer)
     {
-      free (indBuffer);
+      locClientIndPoolPut(&pCallbackData->indPool, indBuffer, indPoolClass);
     }
   }
   else // Id not found
@@ -1782,6 +1988,9 @@ locClientStatusEnumType locClientOpenInstance (
       break;
     }
 
+    // indications can arrive as soon as the control point is up
+    locClientIndPoolInit(&pCallbackData->indPool);
+
     /* Initialize the QMI control point; this function will block
      * until a service is up or a timeout occurs. If the connection to
      * the service succeeds the callback data will be filled in with
@@ -1797,6 +2006,7 @@ locClientStatusEnumType locClientOpenInstance (
 
     if(status != eLOC_CLIENT_SUCCESS)
     {
+      locClientIndPoolDestroy(&pCallbackData->indPool);
       free(pCallbackData);
       pCallbackData = NULL;
       LOC_LOGE ("%s:%d] locClientQmiCtrlPointInit returned %d\n",
@@ -1989,6 +2199,9 @@ locClientStatusEnumType locClientClose(
     return(eLOC_CLIENT_FAILURE_INTERNAL);
   }
 
+  // no more indications after the release, the pool can go
+  locClientIndPoolDestroy(&pCallbackData->indPool);
+
   /* clear the memory allocated to callback data to minimize the chances
    *  of a race condition occurring between close and the indication
    *  callback
@@ -24,6 +24,8 @@ LOCAL_SRC_FILES += \
     LocTimer.cpp \
     LocThread.cpp \
     MsgTask.cpp \
+    LocLatency.cpp \
+    LocExecutor.cpp \
     loc_misc_utils.cpp
 
 # Flag -std=c++11 is not accepted by compiler when LOCAL_CLANG is set to true
@@ -52,6 +54,8 @@ LOCAL_COPY_HEADERS:= \
    LocHeap.h \
    LocThread.h \
    LocTimer.h \
+   LocLatency.h \
+   LocExecutor.h \
    loc_target.h \
    loc_timer.h \
    LocSharedLock.h \
@@ -0,0 +1,310 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocExecutor"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <LocExecutor.h>
+#include <LocThread.h>
+#include <MsgTask.h>
+#include <platform_lib_includes.h>
+
+struct LocStrand::Node {
+    Node* mNext;
+    const LocMsg* mMsg;
+};
+
+static uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// never called with the executor lock held, since msg destructors
+// may post again
+void LocStrand::deleteNodes(Node* node) {
+    while (NULL != node) {
+        Node* next = node->mNext;
+        delete node->mMsg;
+        delete node;
+        node = next;
+    }
+}
+
+class LocExecutorWorker : public LocRunnable {
+    LocExecutor& mExecutor;
+public:
+    inline LocExecutorWorker(LocExecutor& executor) :
+        LocRunnable(), mExecutor(executor) {}
+    inline virtual bool run() {
+        mExecutor.work();
+        return true;
+    }
+    inline virtual void prerun() {
+        // same as MsgTask, do not run in background scheduling group
+        platform_lib_abstraction_set_sched_policy(
+            platform_lib_abstraction_gettid(), PLA_SP_FOREGROUND);
+    }
+};
+
+LocStrand::LocStrand(LocExecutor& executor, const char* name) :
+    mExecutor(executor), mHead(NULL), mTail(NULL),
+    mNextReady(NULL), mNextStrand(NULL),
+    mScheduled(false), mClosed(false) {
+    memset(&mStats, 0, sizeof(mStats));
+    strlcpy(mName, NULL != name ? name : "LocStrand", sizeof(mName));
+}
+
+LocStrand::~LocStrand() {
+    deleteNodes(mHead);
+}
+
+void LocStrand::post(const LocMsg* msg) {
+    Node* node = new Node;
+    node->mNext = NULL;
+    node->mMsg = msg;
+
+    pthread_mutex_lock(&mExecutor.mLock);
+    if (mClosed) {
+        pthread_mutex_unlock(&mExecutor.mLock);
+        deleteNodes(node);
+        return;
+    }
+
+    if (NULL == mTail) {
+        mHead = node;
+    } else {
+        mTail->mNext = node;
+    }
+    mTail = node;
+    if (++mStats.depth > mStats.maxDepth) {
+        mStats.maxDepth = mStats.depth;
+    }
+
+    if (!mScheduled) {
+        mScheduled = true;
+        mExecutor.scheduleLocked(this);
+    } else if (0 == mExecutor.mWorkers) {
+        // queued while no worker could be started, try again
+        mExecutor.startWorkerLocked();
+    }
+    pthread_mutex_unlock(&mExecutor.mLock);
+}
+
+void LocStrand::close() {
+    Node* dropped = NULL;
+    bool idle = false;
+
+    pthread_mutex_lock(&mExecutor.mLock);
+    mClosed = true;
+    dropped = mHead;
+    mHead = mTail = NULL;
+    mStats.depth = 0;
+    idle = !mScheduled;
+    if (idle) {
+        mExecutor.unlinkLocked(this);
+    }
+    pthread_mutex_unlock(&mExecutor.mLock);
+
+    deleteNodes(dropped);
+    if (idle) {
+        delete this;
+    }
+    // else the worker running this strand deletes it when done
+}
+
+void LocStrand::getStats(LocStrandStats& stats) {
+    pthread_mutex_lock(&mExecutor.mLock);
+    stats = mStats;
+    pthread_mutex_unlock(&mExecutor.mLock);
+}
+
+LocExecutor* LocExecutor::sInstance = NULL;
+static pthread_once_t sExecutorOnce = PTHREAD_ONCE_INIT;
+
+void LocExecutor::create() {
+    // lives as long as the process, as do its workers
+    sInstance = new LocExecutor();
+}
+
+LocExecutor::LocExecutor() :
+    mReadyHead(NULL), mReadyTail(NULL), mStrands(NULL),
+    mWorkers(0), mIdleWorkers(0) {
+    pthread_mutex_init(&mLock, NULL);
+    pthread_cond_init(&mCond, NULL);
+}
+
+LocExecutor& LocExecutor::getInstance() {
+    pthread_once(&sExecutorOnce, create);
+    return *sInstance;
+}
+
+LocStrand* LocExecutor::createStrand(const char* name) {
+    LocStrand* strand = new LocStrand(*this, name);
+
+    pthread_mutex_lock(&mLock);
+    strand->mNextStrand = mStrands;
+    mStrands = strand;
+    pthread_mutex_unlock(&mLock);
+
+    return strand;
+}
+
+void LocExecutor::scheduleLocked(LocStrand* strand) {
+    strand->mNextReady = NULL;
+    if (NULL == mReadyTail) {
+        mReadyHead = strand;
+    } else {
+        mReadyTail->mNextReady = strand;
+    }
+    mReadyTail = strand;
+
+    if (mIdleWorkers > 0) {
+        pthread_cond_signal(&mCond);
+    } else if (mWorkers < LOC_EXECUTOR_MAX_WORKERS) {
+        startWorkerLocked();
+    }
+}
+
+void LocExecutor::startWorkerLocked() {
+    LocThread* thread = new LocThread();
+    char name[16];
+    snprintf(name, sizeof(name), "LocExecutor%u", mWorkers);
+    // detached; the worker thread object lives as long as the process
+    if (thread->start(name, new LocExecutorWorker(*this), false)) {
+        mWorkers++;
+    } else {
+        LOC_LOGE("%s: could not start worker %u", __func__, mWorkers);
+        delete thread;
+    }
+}
+
+void LocExecutor::unlinkLocked(LocStrand* strand) {
+    for (LocStrand** link = &mStrands; NULL != *link;
+         link = &(*link)->mNextStrand) {
+        if (*link == strand) {
+            *link = strand->mNextStrand;
+            break;
+        }
+    }
+}
+
+void LocExecutor::work() {
+    pthread_mutex_lock(&mLock);
+    while (NULL == mReadyHead) {
+        mIdleWorkers++;
+        pthread_cond_wait(&mCond, &mLock);
+        mIdleWorkers--;
+    }
+    LocStrand* strand = mReadyHead;
+    mReadyHead = strand->mNextReady;
+    if (NULL == mReadyHead) {
+        mReadyTail = NULL;
+    }
+
+    for (int i = 0; i < LOC_STRAND_BATCH && NULL != strand->mHead; i++) {
+        LocStrand::Node* node = strand->mHead;
+        strand->mHead = node->mNext;
+        node->mNext = NULL;
+        if (NULL == strand->mHead) {
+            strand->mTail = NULL;
+        }
+        strand->mStats.depth--;
+        pthread_mutex_unlock(&mLock);
+
+        uint64_t startNs = nowNs();
+        node->mMsg->log();
+        // there is where each individual msg handling is invoked
+        node->mMsg->proc();
+        LocStrand::deleteNodes(node);
+        uint64_t runNs = nowNs() - startNs;
+
+        pthread_mutex_lock(&mLock);
+        strand->mStats.msgCount++;
+        strand->mStats.runNs += runNs;
+        if (runNs > strand->mStats.maxRunNs) {
+            strand->mStats.maxRunNs = runNs;
+        }
+    }
+
+    if (strand->mClosed) {
+        unlinkLocked(strand);
+        pthread_mutex_unlock(&mLock);
+        delete strand;
+        return;
+    }
+
+    if (NULL != strand->mHead) {
+        // more to do, go to the back of the line
+        scheduleLocked(strand);
+    } else {
+        strand->mScheduled = false;
+    }
+    pthread_mutex_unlock(&mLock);
+}
+
+size_t LocExecutor::dump(char* buf, size_t size) {
+    size_t len = 0;
+    int n;
+
+    if (NULL == buf || 0 == size) {
+        return 0;
+    }
+    buf[0] = '\0';
+
+#define DUMP_APPEND(...)                                            \
+    if (len < size &&                                               \
+        (n = snprintf(buf + len, size - len, __VA_ARGS__)) > 0) {  \
+        len += n;                                                   \
+        if (len >= size) {                                          \
+            len = size - 1;                                         \
+        }                                                           \
+    }
+
+    pthread_mutex_lock(&mLock);
+    DUMP_APPEND("Msg strands on %u of %u workers\n",
+                mWorkers, LOC_EXECUTOR_MAX_WORKERS);
+    DUMP_APPEND("%-24s %6s %6s %10s %10s %10s\n", "strand", "depth",
+                "max", "msgs", "mean(us)", "max(us)");
+    for (LocStrand* strand = mStrands; NULL != strand;
+         strand = strand->mNextStrand) {
+        const LocStrandStats& s = strand->mStats;
+        DUMP_APPEND("%-24s %6u %6u %10llu %10llu %10llu\n", strand->mName,
+                    s.depth, s.maxDepth, (unsigned long long)s.msgCount,
+                    (unsigned long long)(s.msgCount ? s.runNs / s.msgCount / 1000 : 0),
+                    (unsigned long long)(s.maxRunNs / 1000));
+    }
+    pthread_mutex_unlock(&mLock);
+
+#undef DUMP_APPEND
+
+    return len;
+}
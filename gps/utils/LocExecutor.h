@@ -0,0 +1,116 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_EXECUTOR__
+#define __LOC_EXECUTOR__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+struct LocMsg;
+class LocExecutor;
+class LocExecutorWorker;
+
+// Most msgs a worker runs off one strand before letting the other
+// ready strands have a turn
+#define LOC_STRAND_BATCH          8
+// Upper bound of the worker pool shared by all strands
+#define LOC_EXECUTOR_MAX_WORKERS  2
+#define LOC_STRAND_NAME_LENGTH    32
+
+struct LocStrandStats {
+    uint32_t depth;       // msgs waiting right now
+    uint32_t maxDepth;
+    uint64_t msgCount;    // msgs run
+    uint64_t runNs;       // total time spent in proc()
+    uint64_t maxRunNs;
+};
+
+// A serial queue of LocMsgs run on the shared executor. Msgs of one
+// strand run one at a time, in the order they were posted, though not
+// necessarily on the same thread; msgs of different strands may run
+// at the same time.
+class LocStrand {
+    friend class LocExecutor;
+    struct Node;
+    LocExecutor& mExecutor;
+    char mName[LOC_STRAND_NAME_LENGTH];
+    Node* mHead;
+    Node* mTail;
+    LocStrand* mNextReady;
+    LocStrand* mNextStrand;
+    // queued on the executor or being run by a worker
+    bool mScheduled;
+    bool mClosed;
+    LocStrandStats mStats;
+
+    LocStrand(LocExecutor& executor, const char* name);
+    ~LocStrand();
+    // frees a chain of nodes and their msgs
+    static void deleteNodes(Node* node);
+public:
+    // takes ownership of msg
+    void post(const LocMsg* msg);
+    // drops the msgs not run yet; the strand frees itself once the
+    // msg being run, if any, returns. Must not be used after this.
+    void close();
+    void getStats(LocStrandStats& stats);
+};
+
+// Bounded pool of worker threads running LocStrands. Workers are only
+// started when a strand gets ready while all the running ones are busy.
+class LocExecutor {
+    friend class LocStrand;
+    friend class LocExecutorWorker;
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+    LocStrand* mReadyHead;
+    LocStrand* mReadyTail;
+    LocStrand* mStrands;
+    uint32_t mWorkers;
+    uint32_t mIdleWorkers;
+    static LocExecutor* sInstance;
+
+    LocExecutor();
+    static void create();
+    // mLock held
+    void scheduleLocked(LocStrand* strand);
+    // mLock held; ready strands wait for the next post if this fails
+    void startWorkerLocked();
+    void unlinkLocked(LocStrand* strand);
+    // worker loop body: waits for a ready strand and runs a batch of it
+    void work();
+public:
+    static LocExecutor& getInstance();
+    LocStrand* createStrand(const char* name);
+    // human readable per strand stats, like loc_latency_dump()
+    size_t dump(char* buf, size_t size);
+};
+
+#endif //__LOC_EXECUTOR__
@@ -0,0 +1,240 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_Latency"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <LocLatency.h>
+#include <platform_lib_includes.h>
+
+// HdrHistogram style log-linear bins over microseconds. Values below
+// 2 * SUB_BINS are counted exactly; above that, each power of 2 range
+// is split into SUB_BINS linear bins, so the error of any reported
+// percentile is bounded by 1 / SUB_BINS (~3%).
+#define SUB_BIN_BITS      5
+#define SUB_BINS          (1 << SUB_BIN_BITS)
+#define EXACT_BINS        (SUB_BINS << 1)
+#define MAX_VALUE_BITS    32
+#define BIN_COUNT         (EXACT_BINS + (MAX_VALUE_BITS - SUB_BIN_BITS - 1) * SUB_BINS)
+#define MAX_VALUE_US      ((1ULL << MAX_VALUE_BITS) - 1)
+
+struct LocLatencyHistogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint32_t bins[BIN_COUNT];
+};
+
+static const char* const sStageNames[LOC_LATENCY_STAGE_MAX] = {
+    "origin->msg_send",
+    "msg_queue",
+    "position_queue",
+    "location_cb",
+    "nmea_cb",
+    "origin->location_cb"
+};
+
+static volatile bool sEnabled = false;
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static LocLatencyHistogram sHistograms[LOC_LATENCY_STAGE_MAX];
+static pthread_once_t sOriginKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t sOriginKey;
+
+static inline int msb(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
+static inline uint32_t binIndex(uint64_t valueUs) {
+    if (valueUs < EXACT_BINS) {
+        return (uint32_t)valueUs;
+    }
+    int shift = msb(valueUs) - SUB_BIN_BITS;
+    return EXACT_BINS + (shift - 1) * SUB_BINS +
+           (uint32_t)((valueUs >> shift) - SUB_BINS);
+}
+
+// highest value that would have been counted into bin index
+static inline uint64_t binHighest(uint32_t index) {
+    if (index < EXACT_BINS) {
+        return index;
+    }
+    uint32_t shift = (index - EXACT_BINS) / SUB_BINS + 1;
+    uint64_t sub = (index - EXACT_BINS) % SUB_BINS + SUB_BINS;
+    return ((sub + 1) << shift) - 1;
+}
+
+static uint64_t percentile(const LocLatencyHistogram& h, double pct) {
+    uint64_t target = (uint64_t)((pct / 100.0) * h.count + 0.5);
+    uint64_t seen = 0;
+
+    if (0 == target) {
+        target = 1;
+    }
+    for (uint32_t i = 0; i < BIN_COUNT; i++) {
+        seen += h.bins[i];
+        if (seen >= target) {
+            uint64_t value = binHighest(i);
+            return value > h.max ? h.max : value;
+        }
+    }
+    return h.max;
+}
+
+static void originKeyDestroy(void* origin) {
+    free(origin);
+}
+
+static void originKeyCreate() {
+    pthread_key_create(&sOriginKey, originKeyDestroy);
+}
+
+void loc_latency_enable(bool enable) {
+    LOC_LOGD("%s:%d]: %s latency stamping", __func__, __LINE__,
+             enable ? "enabling" : "disabling");
+    sEnabled = enable;
+}
+
+bool loc_latency_enabled() {
+    return sEnabled;
+}
+
+uint64_t loc_latency_stamp() {
+    if (!sEnabled) {
+        return 0;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void loc_latency_set_origin(uint64_t stampNs) {
+    pthread_once(&sOriginKeyOnce, originKeyCreate);
+    uint64_t* origin = (uint64_t*)pthread_getspecific(sOriginKey);
+    if (NULL == origin) {
+        if (0 == stampNs ||
+            NULL == (origin = (uint64_t*)malloc(sizeof(*origin)))) {
+            return;
+        }
+        pthread_setspecific(sOriginKey, origin);
+    }
+    *origin = stampNs;
+}
+
+uint64_t loc_latency_get_origin() {
+    if (!sEnabled) {
+        return 0;
+    }
+    pthread_once(&sOriginKeyOnce, originKeyCreate);
+    uint64_t* origin = (uint64_t*)pthread_getspecific(sOriginKey);
+    return (NULL == origin) ? 0 : *origin;
+}
+
+void loc_latency_record(LocLatencyStage stage, uint64_t startNs, uint64_t endNs) {
+    if (!sEnabled || 0 == startNs || endNs < startNs ||
+        stage < 0 || stage >= LOC_LATENCY_STAGE_MAX) {
+        return;
+    }
+
+    uint64_t valueUs = (endNs - startNs) / 1000;
+    if (valueUs > MAX_VALUE_US) {
+        valueUs = MAX_VALUE_US;
+    }
+
+    pthread_mutex_lock(&sLock);
+    LocLatencyHistogram& h = sHistograms[stage];
+    if (0 == h.count || valueUs < h.min) {
+        h.min = valueUs;
+    }
+    if (valueUs > h.max) {
+        h.max = valueUs;
+    }
+    h.count++;
+    h.sum += valueUs;
+    h.bins[binIndex(valueUs)]++;
+    pthread_mutex_unlock(&sLock);
+}
+
+size_t loc_latency_dump(char* buf, size_t size) {
+    size_t len = 0;
+    int n;
+
+    if (NULL == buf || 0 == size) {
+        return 0;
+    }
+    buf[0] = '\0';
+
+#define DUMP_APPEND(...)                                            \
+    if (len < size &&                                               \
+        (n = snprintf(buf + len, size - len, __VA_ARGS__)) > 0) {  \
+        len += n;                                                   \
+        if (len >= size) {                                          \
+            len = size - 1;                                         \
+        }                                                           \
+    }
+
+    DUMP_APPEND("GNSS report latency (us), stamping %s\n",
+                sEnabled ? "on" : "off");
+    DUMP_APPEND("%-20s %8s %8s %8s %8s %8s %8s %8s %8s\n", "stage", "count",
+                "min", "mean", "p50", "p90", "p99", "p99.9", "max");
+
+    pthread_mutex_lock(&sLock);
+    for (int i = 0; i < LOC_LATENCY_STAGE_MAX; i++) {
+        const LocLatencyHistogram& h = sHistograms[i];
+        if (0 == h.count) {
+            DUMP_APPEND("%-20s %8d\n", sStageNames[i], 0);
+            continue;
+        }
+        DUMP_APPEND("%-20s %8llu %8llu %8llu %8llu %8llu %8llu %8llu %8llu\n",
+                    sStageNames[i],
+                    (unsigned long long)h.count,
+                    (unsigned long long)h.min,
+                    (unsigned long long)(h.sum / h.count),
+                    (unsigned long long)percentile(h, 50.0),
+                    (unsigned long long)percentile(h, 90.0),
+                    (unsigned long long)percentile(h, 99.0),
+                    (unsigned long long)percentile(h, 99.9),
+                    (unsigned long long)h.max);
+    }
+    pthread_mutex_unlock(&sLock);
+
+#undef DUMP_APPEND
+
+    return len;
+}
+
+void loc_latency_reset() {
+    pthread_mutex_lock(&sLock);
+    memset(sHistograms, 0, sizeof(sHistograms));
+    pthread_mutex_unlock(&sLock);
+}
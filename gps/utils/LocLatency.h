@@ -0,0 +1,79 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_LATENCY_H__
+#define __LOC_LATENCY_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Stages of the report path that get a latency histogram. "ORIGIN"
+// is the time the report entered LocApiBase::reportPosition(), the
+// first point built from source here (the LocApi itself comes as a
+// prebuilt); stages named ORIGIN_TO_* are therefore cumulative, the
+// others are the cost of a single hop.
+enum LocLatencyStage {
+    LOC_LATENCY_ORIGIN_TO_MSG_SEND = 0,   // reportPosition -> LocEngReportPosition sent
+    LOC_LATENCY_MSG_QUEUE,                // MsgTask::sendMsg -> LocMsg::proc, any msg
+    LOC_LATENCY_POSITION_QUEUE,           // LocEngReportPosition sent -> proc
+    LOC_LATENCY_LOCATION_CB,              // time spent in location_cb
+    LOC_LATENCY_NMEA_CB,                  // time spent in nmea_cb, per sentence
+    LOC_LATENCY_ORIGIN_TO_LOCATION_CB,    // reportPosition -> location_cb returned
+    LOC_LATENCY_STAGE_MAX
+};
+
+// Stamping is off by default; when off every call below except
+// loc_latency_enable() and loc_latency_dump() is a cheap no-op.
+void loc_latency_enable(bool enable);
+bool loc_latency_enabled();
+
+// CLOCK_MONOTONIC in nanoseconds, 0 if stamping is disabled
+uint64_t loc_latency_stamp();
+
+// Per-thread origin stamp. LocApiBase::reportPosition() sets it on
+// the LocApi's callback thread before fanning the report out,
+// everything downstream on the same thread can read it back.
+void loc_latency_set_origin(uint64_t stampNs);
+uint64_t loc_latency_get_origin();
+
+// Records (endNs - startNs) into the stage histogram. Either stamp
+// being 0 (stamping off when it was taken) drops the sample.
+void loc_latency_record(LocLatencyStage stage, uint64_t startNs, uint64_t endNs);
+inline void loc_latency_record_since(LocLatencyStage stage, uint64_t startNs) {
+    if (0 != startNs) {
+        loc_latency_record(stage, startNs, loc_latency_stamp());
+    }
+}
+
+// Formats count/min/mean/p50/p90/p99/p99.9/max in microseconds for
+// every stage into buf. Returns the number of characters written,
+// not including the terminating NUL.
+size_t loc_latency_dump(char* buf, size_t size);
+void loc_latency_reset();
+
+#endif //__LOC_LATENCY_H__
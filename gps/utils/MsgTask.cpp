@@ -31,20 +31,50 @@
 
 #include <unistd.h>
 #include <MsgTask.h>
+#include <LocExecutor.h>
 #include <msg_q.h>
 #include <loc_log.h>
+#include <LocLatency.h>
 #include <platform_lib_includes.h>
 
 static void LocMsgDestroy(void* msg) {
     delete (LocMsg*)msg;
 }
 
+// mThread of a MsgTask running as a LocStrand
+static char sStrandTag;
+#define STRAND_TAG ((LocThread*)&sStrandTag)
+
+// Only used while latency stamping is on: carries the send time of
+// the wrapped msg across the queue, so LocMsg itself keeps its layout.
+struct LocLatencyMsg : public LocMsg {
+    const LocMsg* mMsg;
+    const uint64_t mSentNs;
+    inline LocLatencyMsg(const LocMsg* msg, uint64_t sentNs) :
+        LocMsg(), mMsg(msg), mSentNs(sentNs) {}
+    inline virtual ~LocLatencyMsg() { delete mMsg; }
+    inline virtual void proc() const {
+        loc_latency_record_since(LOC_LATENCY_MSG_QUEUE, mSentNs);
+        mMsg->proc();
+    }
+    inline virtual void log() const { mMsg->log(); }
+};
+
 MsgTask::MsgTask(LocThread::tCreate tCreator,
                  const char* threadName, bool joinable) :
     mQ(msg_q_init2()), mThread(new LocThread()) {
     if (!mThread->start(tCreator, threadName, this, joinable)) {
         delete mThread;
-        mThread = NULL;
+        if (NULL != tCreator) {
+            // no strand fallback: the msgs need a thread made by
+            // tCreator, e.g. one attached to the JVM
+            mThread = NULL;
+            return;
+        }
+        // still get the msgs run, if on a shared thread
+        msg_q_destroy((void**)&mQ);
+        mQ = LocExecutor::getInstance().createStrand(threadName);
+        mThread = STRAND_TAG;
     }
 }
 
@@ -52,16 +82,36 @@ MsgTask::MsgTask(const char* threadName, bool joinable) :
     mQ(msg_q_init2()), mThread(new LocThread()) {
     if (!mThread->start(threadName, this, joinable)) {
         delete mThread;
-        mThread = NULL;
+        // still get the msgs run, if on a shared thread
+        msg_q_destroy((void**)&mQ);
+        mQ = LocExecutor::getInstance().createStrand(threadName);
+        mThread = STRAND_TAG;
     }
 }
 
+MsgTask* MsgTask::createStrand(const char* name) {
+    return new MsgTask(LocExecutor::getInstance().createStrand(name),
+                       STRAND_TAG);
+}
+
+bool MsgTask::isStrand() const {
+    return STRAND_TAG == mThread;
+}
+
 MsgTask::~MsgTask() {
+    if (isStrand()) {
+        ((LocStrand*)mQ)->close();
+        return;
+    }
     msg_q_flush((void*)mQ);
     msg_q_destroy((void**)&mQ);
 }
 
 void MsgTask::destroy() {
+    if (isStrand()) {
+        delete this;
+        return;
+    }
     msg_q_unblock((void*)mQ);
     if (mThread) {
         LocThread* thread = mThread;
@@ -73,6 +123,14 @@ void MsgTask::destroy() {
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
+    uint64_t sentNs = loc_latency_stamp();
+    if (0 != sentNs) {
+        msg = new LocLatencyMsg(msg, sentNs);
+    }
+    if (isStrand()) {
+        ((LocStrand*)mQ)->post(msg);
+        return;
+    }
     msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
 }
 
@@ -39,14 +39,24 @@ struct LocMsg {
 };
 
 class MsgTask : public LocRunnable {
+    // a msg_q with its own thread, or a LocStrand on the shared
+    // LocExecutor when mThread is the strand tag
     const void* mQ;
     LocThread* mThread;
     friend class LocThreadDelegate;
+    inline MsgTask(const void* strand, LocThread* tag) :
+        mQ(strand), mThread(tag) {}
+    bool isStrand() const;
 protected:
     virtual ~MsgTask();
 public:
     MsgTask(LocThread::tCreate tCreator, const char* threadName = NULL, bool joinable = true);
     MsgTask(const char* threadName = NULL, bool joinable = true);
+    // A MsgTask without a thread of its own. Msgs still run one at a
+    // time in the order they were sent, on the LocExecutor worker
+    // pool. Not for tasks whose msgs block for long, or that need a
+    // thread made by a particular creator.
+    static MsgTask* createStrand(const char* name);
     // this obj will be deleted once thread is deleted
     void destroy();
     void sendMsg(const LocMsg* msg) const;
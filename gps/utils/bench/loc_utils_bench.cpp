@@ -0,0 +1,471 @@
+/* Copyright (c) 2016, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+/* Host benchmarks for the gps.utils primitives: msg_q, MsgTask, LocTimer,
+   LocHeap and linked_list. Each result is printed to stdout as one JSON
+   object per line, so runs can be diffed or collected by a script.
+
+   build: make check (or compile this file against libgps_utils_so)
+   run:   loc_utils_bench [scale]
+          scale multiplies the iteration counts, 1 by default */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <msg_q.h>
+#include <linked_list.h>
+#include <MsgTask.h>
+#include <LocTimer.h>
+#include <LocHeap.h>
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* latency samples of one benchmark run */
+struct BenchSamples {
+    uint64_t* mV;
+    uint32_t mCount;
+    uint32_t mSize;
+
+    inline BenchSamples(uint32_t size) :
+        mV(new uint64_t[size]), mCount(0), mSize(size) {}
+    inline ~BenchSamples() { delete[] mV; }
+    inline void add(uint64_t v) {
+        if (mCount < mSize) {
+            mV[mCount++] = v;
+        }
+    }
+    static int compare(const void* a, const void* b) {
+        uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+        return x < y ? -1 : x > y;
+    }
+    // sorts the samples; call before percentile()
+    void sort() { qsort(mV, mCount, sizeof(mV[0]), compare); }
+    inline uint64_t percentile(uint32_t pct) const {
+        return mCount ? mV[(uint64_t)(mCount - 1) * pct / 100] : 0;
+    }
+    double mean() const {
+        double sum = 0;
+        for (uint32_t i = 0; i < mCount; i++) {
+            sum += mV[i];
+        }
+        return mCount ? sum / mCount : 0;
+    }
+    double stddev() const {
+        double m = mean(), sum = 0;
+        for (uint32_t i = 0; i < mCount; i++) {
+            sum += (mV[i] - m) * (mV[i] - m);
+        }
+        return mCount ? sqrt(sum / mCount) : 0;
+    }
+};
+
+/* prints one result line; params is a JSON fragment such as
+   "\"producers\":4" or NULL, samples may be NULL */
+static void emit(const char* bench, const char* params, uint64_t ops,
+                 uint64_t totalNs, BenchSamples* samples)
+{
+    printf("{\"bench\":\"%s\"", bench);
+    if (params != NULL) {
+        printf(",%s", params);
+    }
+    printf(",\"ops\":%llu,\"total_ns\":%llu,\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f",
+           (unsigned long long)ops, (unsigned long long)totalNs,
+           ops ? (double)totalNs / ops : 0.0,
+           totalNs ? ops * 1e9 / totalNs : 0.0);
+    if (samples != NULL && samples->mCount > 0) {
+        samples->sort();
+        printf(",\"samples\":%u,\"mean_ns\":%.0f,\"stddev_ns\":%.0f"
+               ",\"min_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu",
+               samples->mCount, samples->mean(), samples->stddev(),
+               (unsigned long long)samples->mV[0],
+               (unsigned long long)samples->percentile(50),
+               (unsigned long long)samples->percentile(99),
+               (unsigned long long)samples->mV[samples->mCount - 1]);
+    }
+    printf("}\n");
+    fflush(stdout);
+}
+
+/* a counter one thread can wait on until it reaches a target */
+struct BenchLatch {
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    uint32_t mCount;
+
+    inline BenchLatch() : mCount(0) {
+        pthread_mutex_init(&mMutex, NULL);
+        pthread_cond_init(&mCond, NULL);
+    }
+    inline ~BenchLatch() {
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mMutex);
+    }
+    inline void reset() {
+        pthread_mutex_lock(&mMutex);
+        mCount = 0;
+        pthread_mutex_unlock(&mMutex);
+    }
+    inline void countDown() {
+        pthread_mutex_lock(&mMutex);
+        mCount++;
+        pthread_cond_broadcast(&mCond);
+        pthread_mutex_unlock(&mMutex);
+    }
+    inline void await(uint32_t target) {
+        pthread_mutex_lock(&mMutex);
+        while (mCount < target) {
+            pthread_cond_wait(&mCond, &mMutex);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+};
+
+/* ---------------------------------------------------------------- msg_q */
+
+struct MsgQProducer {
+    void* mQ;
+    uint32_t mCount;
+};
+
+static void* msgQProduce(void* arg)
+{
+    MsgQProducer* p = (MsgQProducer*)arg;
+    for (uint32_t i = 0; i < p->mCount; i++) {
+        msg_q_snd(p->mQ, p, NULL);
+    }
+    return NULL;
+}
+
+struct MsgQEcho {
+    void* mIn;
+    void* mOut;
+};
+
+// sends every msg of mIn back on mOut until it gets the MsgQEcho itself
+static void* msgQEcho(void* arg)
+{
+    MsgQEcho* e = (MsgQEcho*)arg;
+    void* msg = NULL;
+    for (;;) {
+        msg_q_rcv(e->mIn, &msg);
+        if (msg == e) {
+            return NULL;
+        }
+        msg_q_snd(e->mOut, msg, NULL);
+    }
+}
+
+static void benchMsgQ(uint32_t scale)
+{
+    static const uint32_t producerCounts[] = { 1, 2, 4, 8 };
+    const uint32_t perProducer = 50000 * scale;
+    const uint32_t pings = 20000 * scale;
+
+    // throughput: producers flood the queue while one thread drains it
+    for (uint32_t n = 0; n < sizeof(producerCounts) / sizeof(producerCounts[0]); n++) {
+        uint32_t producers = producerCounts[n];
+        uint32_t total = producers * perProducer;
+        MsgQProducer* p = new MsgQProducer[producers];
+        pthread_t* threads = new pthread_t[producers];
+        void* q = NULL;
+        char params[32];
+
+        msg_q_init(&q);
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < producers; i++) {
+            p[i].mQ = q;
+            p[i].mCount = perProducer;
+            pthread_create(&threads[i], NULL, msgQProduce, &p[i]);
+        }
+        for (uint32_t i = 0; i < total; i++) {
+            void* msg = NULL;
+            msg_q_rcv(q, &msg);
+        }
+        uint64_t elapsed = nowNs() - start;
+        for (uint32_t i = 0; i < producers; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        msg_q_destroy(&q);
+
+        snprintf(params, sizeof(params), "\"producers\":%u", producers);
+        emit("msg_q_snd_rcv", params, total, elapsed, NULL);
+
+        delete[] threads;
+        delete[] p;
+    }
+
+    // latency: one msg in flight, round trip through an echo thread
+    BenchSamples latency(pings);
+    MsgQEcho echo = { NULL, NULL };
+    pthread_t thread;
+    static int ping;
+
+    msg_q_init(&echo.mIn);
+    msg_q_init(&echo.mOut);
+    pthread_create(&thread, NULL, msgQEcho, &echo);
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < pings; i++) {
+        void* msg = NULL;
+        uint64_t t = nowNs();
+        msg_q_snd(echo.mIn, &ping, NULL);
+        msg_q_rcv(echo.mOut, &msg);
+        latency.add(nowNs() - t);
+    }
+    uint64_t elapsed = nowNs() - start;
+    msg_q_snd(echo.mIn, &echo, NULL);
+    pthread_join(thread, NULL);
+    msg_q_destroy(&echo.mIn);
+    msg_q_destroy(&echo.mOut);
+
+    emit("msg_q_round_trip", NULL, pings, elapsed, &latency);
+}
+
+/* -------------------------------------------------------------- MsgTask */
+
+struct BenchMsg : public LocMsg {
+    BenchLatch& mLatch;
+    inline BenchMsg(BenchLatch& latch) : LocMsg(), mLatch(latch) {}
+    inline virtual void proc() const { mLatch.countDown(); }
+};
+
+static void benchMsgTaskOne(const char* kind, MsgTask* task, uint32_t scale)
+{
+    BenchLatch latch;
+    const uint32_t burst = 100000 * scale;
+    const uint32_t pings = 2000 * scale;
+    char params[32];
+
+    snprintf(params, sizeof(params), "\"task\":\"%s\"", kind);
+
+    // throughput: a burst of msgs, timed until the last one ran
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < burst; i++) {
+        task->sendMsg(new BenchMsg(latch));
+    }
+    latch.await(burst);
+    emit("msg_task_throughput", params, burst, nowNs() - start, NULL);
+
+    // latency: one msg at a time, from sendMsg() until it ran
+    BenchSamples latency(pings);
+    latch.reset();
+    start = nowNs();
+    for (uint32_t i = 0; i < pings; i++) {
+        uint64_t t = nowNs();
+        task->sendMsg(new BenchMsg(latch));
+        latch.await(i + 1);
+        latency.add(nowNs() - t);
+    }
+    emit("msg_task_latency", params, pings, nowNs() - start, &latency);
+}
+
+static void benchMsgTask(uint32_t scale)
+{
+    MsgTask* thread = new MsgTask("LocBenchTask", false);
+    benchMsgTaskOne("thread", thread, scale);
+    thread->destroy();
+
+    MsgTask* strand = MsgTask::createStrand("LocBenchStrand");
+    benchMsgTaskOne("strand", strand, scale);
+    strand->destroy();
+}
+
+/* ------------------------------------------------------------- LocTimer */
+
+class BenchTimer : public LocTimer {
+public:
+    BenchLatch mLatch;
+    volatile uint64_t mExpiredNs;
+    inline BenchTimer() : LocTimer(), mExpiredNs(0) {}
+    inline virtual void timeOutCallback() {
+        mExpiredNs = nowNs();
+        mLatch.countDown();
+    }
+};
+
+static void benchLocTimer(uint32_t scale)
+{
+    static const uint32_t timeouts[] = { 1, 10, 50 };
+    BenchTimer timer;
+    char params[48];
+
+    // accuracy and jitter: how late after its timeout a timer fires
+    for (uint32_t n = 0; n < sizeof(timeouts) / sizeof(timeouts[0]); n++) {
+        uint32_t timeoutMs = timeouts[n];
+        uint32_t runs = (timeoutMs >= 50 ? 20 : 100) * scale;
+        BenchSamples lateness(runs);
+
+        timer.mLatch.reset();
+        uint64_t start = nowNs();
+        for (uint32_t i = 0; i < runs; i++) {
+            uint64_t t = nowNs();
+            if (!timer.start(timeoutMs, false)) {
+                fprintf(stderr, "LocTimer start failed\n");
+                return;
+            }
+            timer.mLatch.await(i + 1);
+            int64_t late = (int64_t)(timer.mExpiredNs - t) - timeoutMs * 1000000LL;
+            lateness.add(late > 0 ? late : 0);
+        }
+        snprintf(params, sizeof(params), "\"timeout_ms\":%u", timeoutMs);
+        emit("loc_timer_expire_lateness", params, runs, nowNs() - start, &lateness);
+    }
+
+    // cost of arming and disarming a timer that never fires
+    const uint32_t pairs = 20000 * scale;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < pairs; i++) {
+        timer.start(60000, false);
+        timer.stop();
+    }
+    emit("loc_timer_start_stop", NULL, pairs, nowNs() - start, NULL);
+}
+
+/* -------------------------------------------------------------- LocHeap */
+
+class BenchRankable : public LocRankable {
+public:
+    uint32_t mKey;
+    inline BenchRankable() : LocRankable(), mKey(0) {}
+    // smaller keys rank higher, as with timer expiry times
+    inline virtual int ranks(LocRankable& rankable) {
+        BenchRankable& other = static_cast<BenchRankable&>(rankable);
+        return (int)(other.mKey - mKey);
+    }
+};
+
+static void benchLocHeap(uint32_t scale)
+{
+    const uint32_t count = 100000 * scale;
+    BenchRankable* nodes = new BenchRankable[count];
+    LocHeap heap;
+    char params[32];
+
+    srand(1);
+    for (uint32_t i = 0; i < count; i++) {
+        nodes[i].mKey = rand() & 0x7fffffff;
+    }
+    snprintf(params, sizeof(params), "\"size\":%u", count);
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        heap.push(nodes[i]);
+    }
+    emit("loc_heap_push", params, count, nowNs() - start, NULL);
+
+    start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        heap.pop();
+    }
+    emit("loc_heap_pop", params, count, nowNs() - start, NULL);
+
+    // removal of arbitrary nodes, as LocTimer::stop() does; remove()
+    // searches the tree, so time a sample of removals from a full heap
+    const uint32_t removals = 1000 * scale;
+    for (uint32_t i = 0; i < count; i++) {
+        heap.push(nodes[i]);
+    }
+    start = nowNs();
+    for (uint32_t i = 0; i < removals; i++) {
+        heap.remove(nodes[(i * 7919u) % count]);
+    }
+    emit("loc_heap_remove", params, removals, nowNs() - start, NULL);
+
+    delete[] nodes;
+}
+
+/* ---------------------------------------------------------- linked_list */
+
+static bool benchListEqual(void* data0, void* data)
+{
+    return data0 == data;
+}
+
+static void benchLinkedList(uint32_t scale)
+{
+    const uint32_t count = 100000 * scale;
+    const uint32_t searchSize = 1000;
+    const uint32_t searches = 10000 * scale;
+    uint32_t* items = new uint32_t[count];
+    void* list = NULL;
+    void* data = NULL;
+    char params[32];
+
+    linked_list_init(&list);
+    snprintf(params, sizeof(params), "\"size\":%u", count);
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        linked_list_add(list, &items[i], NULL);
+    }
+    emit("linked_list_add", params, count, nowNs() - start, NULL);
+
+    start = nowNs();
+    for (uint32_t i = 0; i < count; i++) {
+        linked_list_remove(list, &data);
+    }
+    emit("linked_list_remove", params, count, nowNs() - start, NULL);
+
+    // search over a short list, hitting every position equally
+    for (uint32_t i = 0; i < searchSize; i++) {
+        linked_list_add(list, &items[i], NULL);
+    }
+    snprintf(params, sizeof(params), "\"size\":%u", searchSize);
+    start = nowNs();
+    for (uint32_t i = 0; i < searches; i++) {
+        linked_list_search(list, &data, benchListEqual, &items[i % searchSize], false);
+    }
+    emit("linked_list_search", params, searches, nowNs() - start, NULL);
+
+    linked_list_destroy(&list);
+    delete[] items;
+}
+
+int main(int argc, char** argv)
+{
+    int scale = argc > 1 ? atoi(argv[1]) : 1;
+    if (scale <= 0) {
+        scale = 1;
+    }
+
+    benchMsgQ(scale);
+    benchMsgTask(scale);
+    benchLocTimer(scale);
+    benchLocHeap(scale);
+    benchLinkedList(scale);
+    return 0;
+}
@@ -35,20 +35,213 @@
 #include <stdlib.h>
 #include <stdint.h>
 
-typedef struct list_element {
-   struct list_element* next;
-   struct list_element* prev;
-   void* data_ptr;
-   void (*dealloc_func)(void*);
-}list_element;
-
+/* nodes carved out of one allocation for the lists below */
+#define LIST_SLAB_NODES 16
+
+typedef struct list_slab {
+   struct list_slab* next;
+   linked_list_node nodes[LIST_SLAB_NODES];
+} list_slab;
+
+/* The list behind the void* handle. Its nodes come from slabs owned by
+   the list and return to its free list when removed, so a list that has
+   reached its usual depth stops allocating. Slabs are released when the
+   list is destroyed. */
 typedef struct list_state {
-   list_element* p_head;
-   list_element* p_tail;
+   linked_list_head list;
+   linked_list_node* free_nodes;
+   list_slab* slabs;
 } list_state;
 
+/*===========================================================================
+FUNCTION    list_node_alloc
+
+DESCRIPTION
+   Takes a node off the free list of a list, adding a slab if it is empty.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The node, or NULL if out of memory.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static linked_list_node* list_node_alloc(list_state* p_list)
+{
+   if( p_list->free_nodes == NULL )
+   {
+      list_slab* slab = (list_slab*)malloc(sizeof(list_slab));
+      if( slab == NULL )
+      {
+         return NULL;
+      }
+      slab->next = p_list->slabs;
+      p_list->slabs = slab;
+
+      int i;
+      for( i = 0; i < LIST_SLAB_NODES - 1; i++ )
+      {
+         slab->nodes[i].next = &slab->nodes[i + 1];
+      }
+      slab->nodes[LIST_SLAB_NODES - 1].next = NULL;
+      p_list->free_nodes = slab->nodes;
+   }
+
+   linked_list_node* node = p_list->free_nodes;
+   p_list->free_nodes = node->next;
+   return node;
+}
+
+static inline void list_node_free(list_state* p_list, linked_list_node* node)
+{
+   node->next = p_list->free_nodes;
+   p_list->free_nodes = node;
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
+/*===========================================================================
+
+  FUNCTION:   linked_list_head_init
+
+  ===========================================================================*/
+void linked_list_head_init(linked_list_head* list)
+{
+   list->p_head = NULL;
+   list->p_tail = NULL;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_node_add
+
+  ===========================================================================*/
+linked_list_err_type linked_list_node_add(linked_list_head* list, linked_list_node* node,
+                                          void* data_obj, void (*dealloc)(void*))
+{
+   if( list == NULL || node == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   if( data_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid input parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   node->data_ptr = data_obj;
+   node->dealloc_func = dealloc;
+   node->prev = NULL;
+
+   /* Replace head element */
+   node->next = list->p_head;
+   if( list->p_head != NULL )
+   {
+      list->p_head->prev = node;
+   }
+   else
+   {
+      list->p_tail = node;
+   }
+   list->p_head = node;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_node_remove
+
+  ===========================================================================*/
+linked_list_err_type linked_list_node_remove(linked_list_head* list, void** data_obj)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   if( data_obj == NULL )
+   {
+      LOC_LOGE("%s: Invalid input parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   linked_list_node* tmp = list->p_tail;
+   if( tmp == NULL )
+   {
+      return eLINKED_LIST_UNAVAILABLE_RESOURCE;
+   }
+
+   linked_list_node_unlink(list, tmp);
+
+   /* Copy data to output param */
+   *data_obj = tmp->data_ptr;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_node_unlink
+
+  ===========================================================================*/
+void linked_list_node_unlink(linked_list_head* list, linked_list_node* node)
+{
+   if( node->prev == NULL )
+   {
+      list->p_head = node->next;
+   }
+   else
+   {
+      node->prev->next = node->next;
+   }
+
+   if( node->next == NULL )
+   {
+      list->p_tail = node->prev;
+   }
+   else
+   {
+      node->next->prev = node->prev;
+   }
+
+   node->prev = node->next = NULL;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_node_flush
+
+  ===========================================================================*/
+void linked_list_node_flush(linked_list_head* list)
+{
+   linked_list_node* node = list->p_head;
+
+   list->p_head = NULL;
+   list->p_tail = NULL;
+
+   while( node != NULL )
+   {
+      /* the node may live inside the data dealloc frees */
+      linked_list_node* next = node->next;
+      node->prev = node->next = NULL;
+
+      /* Free data pointer if told to do so. */
+      if( node->dealloc_func != NULL )
+      {
+         node->dealloc_func(node->data_ptr);
+      }
+
+      node = next;
+   }
+}
+
 /*===========================================================================
 
   FUNCTION:   linked_list_init
@@ -70,8 +263,9 @@ linked_list_err_type linked_list_init(void** list_data)
       return eLINKED_LIST_FAILURE_GENERAL;
    }
 
-   tmp_list->p_head = NULL;
-   tmp_list->p_tail = NULL;
+   linked_list_head_init(&tmp_list->list);
+   tmp_list->free_nodes = NULL;
+   tmp_list->slabs = NULL;
 
    *list_data = tmp_list;
 
@@ -95,6 +289,13 @@ linked_list_err_type linked_list_destroy(void** list_data)
 
    linked_list_flush(p_list);
 
+   while( p_list->slabs != NULL )
+   {
+      list_slab* slab = p_list->slabs;
+      p_list->slabs = slab->next;
+      free(slab);
+   }
+
    free(*list_data);
    *list_data = NULL;
 
@@ -122,35 +323,14 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    }
 
    list_state* p_list = (list_state*)list_data;
-   list_element* elem = (list_element*)malloc(sizeof(list_element));
+   linked_list_node* elem = list_node_alloc(p_list);
    if( elem == NULL )
    {
       LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
       return eLINKED_LIST_FAILURE_GENERAL;
    }
 
-   /* Copy data to newly created element */
-   elem->data_ptr = data_obj;
-   elem->next = NULL;
-   elem->prev = NULL;
-   elem->dealloc_func = dealloc;
-
-   /* Replace head element */
-   list_element* tmp = p_list->p_head;
-   p_list->p_head = elem;
-   /* Point next to the previous head element */
-   p_list->p_head->next = tmp;
-
-   if( tmp != NULL )
-   {
-      tmp->prev = p_list->p_head;
-   }
-   else
-   {
-      p_list->p_tail = p_list->p_head;
-   }
-
-   return eLINKED_LIST_SUCCESS;
+   return linked_list_node_add(&p_list->list, elem, data_obj, dealloc);
 }
 
 /*===========================================================================
@@ -174,30 +354,19 @@ linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
    }
 
    list_state* p_list = (list_state*)list_data;
-   if( p_list->p_tail == NULL )
+   linked_list_node* tmp = p_list->list.p_tail;
+   if( tmp == NULL )
    {
       return eLINKED_LIST_UNAVAILABLE_RESOURCE;
    }
 
-   list_element* tmp = p_list->p_tail;
-
-   /* Replace tail element */
-   p_list->p_tail = tmp->prev;
-
-   if( p_list->p_tail != NULL )
-   {
-      p_list->p_tail->next = NULL;
-   }
-   else
-   {
-      p_list->p_head = p_list->p_tail;
-   }
+   linked_list_node_unlink(&p_list->list, tmp);
 
    /* Copy data to output param */
    *data_obj = tmp->data_ptr;
 
-   /* Free allocated list element */
-   free(tmp);
+   /* Return list element to the slab */
+   list_node_free(p_list, tmp);
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -217,7 +386,7 @@ int linked_list_empty(void* list_data)
    else
    {
       list_state* p_list = (list_state*)list_data;
-      return p_list->p_head == NULL ? 1 : 0;
+      return linked_list_node_empty(&p_list->list);
    }
 }
 
@@ -236,25 +405,21 @@ linked_list_err_type linked_list_flush(void* list_data)
 
    list_state* p_list = (list_state*)list_data;
 
-   /* Remove all dynamically allocated elements */
-   while( p_list->p_head != NULL )
+   /* Remove all elements, returning them to the slab */
+   while( p_list->list.p_head != NULL )
    {
-      list_element* tmp = p_list->p_head->next;
+      linked_list_node* tmp = p_list->list.p_head;
+      linked_list_node_unlink(&p_list->list, tmp);
 
       /* Free data pointer if told to do so. */
-      if( p_list->p_head->dealloc_func != NULL )
+      if( tmp->dealloc_func != NULL )
       {
-         p_list->p_head->dealloc_func(p_list->p_head->data_ptr);
+         tmp->dealloc_func(tmp->data_ptr);
       }
 
-      /* Free list element */
-      free(p_list->p_head);
-
-      p_list->p_head = tmp;
+      list_node_free(p_list, tmp);
    }
 
-   p_list->p_tail = NULL;
-
    return eLINKED_LIST_SUCCESS;
 }
 
@@ -276,12 +441,12 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
    }
 
    list_state* p_list = (list_state*)list_data;
-   if( p_list->p_tail == NULL )
+   if( p_list->list.p_tail == NULL )
    {
       return eLINKED_LIST_UNAVAILABLE_RESOURCE;
    }
 
-   list_element* tmp = p_list->p_head;
+   linked_list_node* tmp = p_list->list.p_head;
 
    if (NULL != data_p) {
      *data_p = NULL;
@@ -294,26 +459,14 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
        }
 
        if (rm_if_found) {
-         if (NULL == tmp->prev) {
-           p_list->p_head = tmp->next;
-         } else {
-           tmp->prev->next = tmp->next;
-         }
-
-         if (NULL == tmp->next) {
-           p_list->p_tail = tmp->prev;
-         } else {
-           tmp->next->prev = tmp->prev;
-         }
-
-         tmp->prev = tmp->next = NULL;
+         linked_list_node_unlink(&p_list->list, tmp);
 
          // dealloc data if it is not copied out && caller
          // has given us a dealloc function pointer.
          if (NULL == data_p && NULL != tmp->dealloc_func) {
              tmp->dealloc_func(tmp->data_ptr);
          }
-         free(tmp);
+         list_node_free(p_list, tmp);
        }
 
        tmp = NULL;
@@ -324,4 +477,3 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
 
    return eLINKED_LIST_SUCCESS;
 }
-
@@ -210,6 +210,144 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
                                         bool (*equal)(void* data_0, void* data),
                                         void* data_0, bool rm_if_found);
 
+/* ---------------------------------------------------------------------------
+   Intrusive lists
+
+   The link lives inside the payload, so adding and removing never allocate.
+   A node may be on at most one list at a time, and must stay valid while
+   it is on it. Ordering matches the list above: nodes are added at the
+   head and removed from the tail.
+   ------------------------------------------------------------------------- */
+typedef struct linked_list_node
+{
+   struct linked_list_node* next;
+   struct linked_list_node* prev;
+   void* data_ptr;                  /* returned by remove, given to dealloc */
+   void (*dealloc_func)(void*);     /* called with data_ptr on flush */
+} linked_list_node;
+
+typedef struct linked_list_head
+{
+   linked_list_node* p_head;
+   linked_list_node* p_tail;
+} linked_list_head;
+
+#define LINKED_LIST_HEAD_INITIALIZER { NULL, NULL }
+
+/*===========================================================================
+FUNCTION    linked_list_head_init
+
+DESCRIPTION
+   Initializes an empty intrusive list.
+
+   list: List to be initialized.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void linked_list_head_init(linked_list_head* list);
+
+/*===========================================================================
+FUNCTION    linked_list_node_add
+
+DESCRIPTION
+   Adds a node to the head of an intrusive list. Usually the node is a
+   member of the object data_obj points to.
+
+   list:     List to add the node to the head of.
+   node:     Node to link in; must not be on any list.
+   data_obj: Pointer returned when the node is removed.
+   dealloc:  Function used to deallocate data_obj during a flush operation.
+             Pass NULL if you do not want data deallocated.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_node_add(linked_list_head* list, linked_list_node* node,
+                                          void* data_obj, void (*dealloc)(void*));
+
+/*===========================================================================
+FUNCTION    linked_list_node_remove
+
+DESCRIPTION
+   Removes the node at the tail of an intrusive list.
+
+   list:     List to remove the tail node from.
+   data_obj: Set to the data_obj the node was added with.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+linked_list_err_type linked_list_node_remove(linked_list_head* list, void** data_obj);
+
+/*===========================================================================
+FUNCTION    linked_list_node_unlink
+
+DESCRIPTION
+   Removes a given node from anywhere in an intrusive list.
+
+   list: List the node is on.
+   node: Node to unlink.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void linked_list_node_unlink(linked_list_head* list, linked_list_node* node);
+
+/*===========================================================================
+FUNCTION    linked_list_node_flush
+
+DESCRIPTION
+   Unlinks all nodes of an intrusive list, calling the dealloc function of
+   every node that has one.
+
+   list: List to flush.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void linked_list_node_flush(linked_list_head* list);
+
+static inline int linked_list_node_empty(const linked_list_head* list)
+{
+   return list->p_head == NULL;
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -37,7 +37,12 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
 #include <loc_cfg.h>
+#include <LocThread.h>
 #include <platform_lib_includes.h>
 #include <loc_misc_utils.h>
 #ifdef USE_GLIB
@@ -71,6 +76,46 @@ typedef struct loc_param_v_type
     double param_double_value;
 }loc_param_v_type;
 
+/* Configuration files are parsed once into a hashed table of items that
+   every config table read from the same file is then filled from. A file
+   is parsed again only when it changes on disk. */
+#define LOC_CFG_HASH_SIZE 64
+
+typedef struct loc_cfg_item_s
+{
+    struct loc_cfg_item_s* next;
+    loc_param_v_type value;
+    char line[LOC_MAX_PARAM_LINE];  /* storage value points into */
+}loc_cfg_item_s_type;
+
+typedef struct loc_cfg_file_s
+{
+    struct loc_cfg_file_s* next;
+    char* name;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    /* with nanoseconds: same size edits within a second are common */
+    struct timespec mtime;
+    loc_cfg_item_s_type* items[LOC_CFG_HASH_SIZE];
+}loc_cfg_file_s_type;
+
+typedef struct loc_cfg_watch_s
+{
+    struct loc_cfg_watch_s* next;
+    char* name;
+    const char* base_name;          /* points into name */
+    int wd;
+    loc_conf_change_cb callback;
+    void* user_data;
+}loc_cfg_watch_s_type;
+
+static pthread_mutex_t loc_cfg_lock = PTHREAD_MUTEX_INITIALIZER;
+static loc_cfg_file_s_type* loc_cfg_files = NULL;
+/* only ever appended to, so the watcher thread walks it unlocked */
+static loc_cfg_watch_s_type* volatile loc_cfg_watches = NULL;
+static int loc_cfg_inotify_fd = -1;
+
 /*===========================================================================
 FUNCTION loc_set_config_entry
 
@@ -158,6 +203,66 @@ int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type*
     return ret;
 }
 
+/*===========================================================================
+FUNCTION loc_parse_conf_item
+
+DESCRIPTION
+   Splits a line of configuration item into its name and value, and parses
+   the value as a number. The name and string value point into input_buf,
+   which is modified.
+
+PARAMETERS:
+   input_buf : buffer contanis config item
+   config_value: parsed item
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   true if the line is a "name = value" item
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static bool loc_parse_conf_item(char* input_buf, loc_param_v_type* config_value)
+{
+    char *lasts;
+    memset(config_value, 0, sizeof(*config_value));
+
+    /* Separate variable and value */
+    config_value->param_name = strtok_r(input_buf, "=", &lasts);
+    /* skip lines that do not contain "=" */
+    if (NULL == config_value->param_name) {
+        return false;
+    }
+    config_value->param_str_value = strtok_r(NULL, "=", &lasts);
+
+    /* skip lines that do not contain two operands */
+    if (NULL == config_value->param_str_value) {
+        return false;
+    }
+
+    /* Trim leading and trailing spaces */
+    loc_util_trim_space(config_value->param_name);
+    loc_util_trim_space(config_value->param_str_value);
+
+    /* Parse numerical value */
+    if ((strlen(config_value->param_str_value) >=3) &&
+        (config_value->param_str_value[0] == '0') &&
+        (tolower(config_value->param_str_value[1]) == 'x'))
+    {
+        /* hex */
+        config_value->param_int_value = (int) strtol(&config_value->param_str_value[2],
+                                                     (char**) NULL, 16);
+    }
+    else {
+        config_value->param_double_value = (double) atof(config_value->param_str_value); /* float */
+        config_value->param_int_value = atoi(config_value->param_str_value); /* dec */
+    }
+
+    return true;
+}
+
 /*===========================================================================
 FUNCTION loc_fill_conf_item
 
@@ -186,41 +291,13 @@ int loc_fill_conf_item(char* input_buf,
     int ret = 0;
 
     if (input_buf && config_table) {
-        char *lasts;
         loc_param_v_type config_value;
-        memset(&config_value, 0, sizeof(config_value));
-
-        /* Separate variable and value */
-        config_value.param_name = strtok_r(input_buf, "=", &lasts);
-        /* skip lines that do not contain "=" */
-        if (config_value.param_name) {
-            config_value.param_str_value = strtok_r(NULL, "=", &lasts);
-
-            /* skip lines that do not contain two operands */
-            if (config_value.param_str_value) {
-                /* Trim leading and trailing spaces */
-                loc_util_trim_space(config_value.param_name);
-                loc_util_trim_space(config_value.param_str_value);
-
-                /* Parse numerical value */
-                if ((strlen(config_value.param_str_value) >=3) &&
-                    (config_value.param_str_value[0] == '0') &&
-                    (tolower(config_value.param_str_value[1]) == 'x'))
-                {
-                    /* hex */
-                    config_value.param_int_value = (int) strtol(&config_value.param_str_value[2],
-                                                                (char**) NULL, 16);
-                }
-                else {
-                    config_value.param_double_value = (double) atof(config_value.param_str_value); /* float */
-                    config_value.param_int_value = atoi(config_value.param_str_value); /* dec */
-                }
 
-                for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
-                {
-                    if(!loc_set_config_entry(&config_table[i], &config_value)) {
-                        ret += 1;
-                    }
+        if (loc_parse_conf_item(input_buf, &config_value)) {
+            for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
+            {
+                if(!loc_set_config_entry(&config_table[i], &config_value)) {
+                    ret += 1;
                 }
             }
         }
@@ -355,6 +432,240 @@ int loc_update_conf(const char* conf_data, int32_t length,
     return ret;
 }
 
+/*===========================================================================
+FUNCTION loc_cfg_hash
+
+DESCRIPTION
+   Hashes a parameter name into the item table of a parsed file.
+
+PARAMETERS:
+   name: parameter name
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   bucket index
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static uint32_t loc_cfg_hash(const char* name)
+{
+    uint32_t hash = 5381;
+    while (*name) {
+        hash = hash * 33 + (unsigned char)*name++;
+    }
+    return hash % LOC_CFG_HASH_SIZE;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_free_items
+
+DESCRIPTION
+   Frees the parsed items of a configuration file.
+
+PARAMETERS:
+   file: parsed configuration file
+
+DEPENDENCIES
+   loc_cfg_lock held
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_free_items(loc_cfg_file_s_type* file)
+{
+    for (uint32_t i = 0; i < LOC_CFG_HASH_SIZE; i++) {
+        while (NULL != file->items[i]) {
+            loc_cfg_item_s_type* item = file->items[i];
+            file->items[i] = item->next;
+            free(item);
+        }
+    }
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_parse_file
+
+DESCRIPTION
+   Parses every "name = value" line of a configuration file into the hashed
+   item table of file, replacing what was there. When a name shows up more
+   than once the last one wins.
+
+PARAMETERS:
+   file: parsed configuration file to fill
+   conf_fp: file pointer
+
+DEPENDENCIES
+   loc_cfg_lock held
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_parse_file(loc_cfg_file_s_type* file, FILE* conf_fp)
+{
+    char input_buf[LOC_MAX_PARAM_LINE];
+    int num_items = 0;
+
+    loc_cfg_free_items(file);
+
+    while (fgets(input_buf, LOC_MAX_PARAM_LINE, conf_fp)) {
+        loc_cfg_item_s_type* item =
+            (loc_cfg_item_s_type*)malloc(sizeof(loc_cfg_item_s_type));
+        if (NULL == item) {
+            LOC_LOGE("%s: out of memory parsing %s", __FUNCTION__, file->name);
+            break;
+        }
+
+        memcpy(item->line, input_buf, sizeof(item->line));
+        if (!loc_parse_conf_item(item->line, &item->value)) {
+            free(item);
+            continue;
+        }
+
+        uint32_t bucket = loc_cfg_hash(item->value.param_name);
+        loc_cfg_item_s_type** link = &file->items[bucket];
+        while (NULL != *link &&
+               strcmp((*link)->value.param_name, item->value.param_name)) {
+            link = &(*link)->next;
+        }
+        if (NULL != *link) {
+            /* replace the earlier definition */
+            item->next = (*link)->next;
+            free(*link);
+        } else {
+            item->next = NULL;
+            num_items++;
+        }
+        *link = item;
+    }
+
+    LOC_LOGD("%s: %s has %d items", __FUNCTION__, file->name, num_items);
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_get_file
+
+DESCRIPTION
+   Finds the parsed copy of a configuration file, parsing the file if it
+   has not been parsed yet, has changed on disk since, or if forced to.
+
+PARAMETERS:
+   conf_file_name: configuration file
+   force: parse the file again even if it looks unchanged
+
+DEPENDENCIES
+   loc_cfg_lock held
+
+RETURN VALUE
+   the parsed file, or NULL if the file can not be read
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static loc_cfg_file_s_type* loc_cfg_get_file(const char* conf_file_name, bool force)
+{
+    loc_cfg_file_s_type* file = loc_cfg_files;
+    struct stat st;
+    FILE *conf_fp = NULL;
+
+    while (NULL != file && strcmp(file->name, conf_file_name)) {
+        file = file->next;
+    }
+
+    if (0 != stat(conf_file_name, &st)) {
+        return NULL;
+    }
+
+    if (NULL != file && !force &&
+        file->dev == st.st_dev && file->ino == st.st_ino &&
+        file->size == st.st_size &&
+        file->mtime.tv_sec == st.st_mtim.tv_sec &&
+        file->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+        return file;
+    }
+
+    if ((conf_fp = fopen(conf_file_name, "r")) == NULL) {
+        return NULL;
+    }
+
+    if (NULL == file) {
+        file = (loc_cfg_file_s_type*)calloc(1, sizeof(loc_cfg_file_s_type));
+        if (NULL == file || NULL == (file->name = strdup(conf_file_name))) {
+            free(file);
+            fclose(conf_fp);
+            return NULL;
+        }
+        file->next = loc_cfg_files;
+        loc_cfg_files = file;
+    }
+
+    file->dev = st.st_dev;
+    file->ino = st.st_ino;
+    file->size = st.st_size;
+    file->mtime = st.st_mtim;
+    loc_cfg_parse_file(file, conf_fp);
+    fclose(conf_fp);
+
+    return file;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_fill_table
+
+DESCRIPTION
+   Sets the entries of a configuration table from a parsed file, with one
+   hash lookup per entry.
+
+PARAMETERS:
+   file: parsed configuration file
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   loc_cfg_lock held
+
+RETURN VALUE
+   number of entries set
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_cfg_fill_table(const loc_cfg_file_s_type* file,
+                              const loc_param_s_type* config_table,
+                              uint32_t table_length)
+{
+    int ret = 0;
+
+    for (uint32_t i = 0; i < table_length; i++)
+    {
+        const loc_param_s_type* entry = &config_table[i];
+        loc_cfg_item_s_type* item = file->items[loc_cfg_hash(entry->param_name)];
+
+        /* Clear the validity bit */
+        if (NULL != entry->param_set)
+        {
+            *(entry->param_set) = 0;
+        }
+
+        while (NULL != item && strcmp(item->value.param_name, entry->param_name)) {
+            item = item->next;
+        }
+        if (NULL != item && !loc_set_config_entry(entry, &item->value)) {
+            ret += 1;
+        }
+    }
+
+    return ret;
+}
+
 /*===========================================================================
 FUNCTION loc_read_conf
 
@@ -362,6 +673,8 @@ DESCRIPTION
    Reads the specified configuration file and sets defined values based on
    the passed in configuration table. This table maps strings to values to
    set along with the type of each of these values.
+   The file is only parsed the first time it is read, or again once it has
+   changed; every other read is served from the parsed copy.
 
 PARAMETERS:
    conf_file_name: configuration file to read
@@ -380,21 +693,163 @@ SIDE EFFECTS
 void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_table,
                    uint32_t table_length)
 {
-    FILE *conf_fp = NULL;
-    char *lasts;
-    loc_param_v_type config_value;
-    uint32_t i;
+    loc_cfg_file_s_type* file = NULL;
 
-    if((conf_fp = fopen(conf_file_name, "r")) != NULL)
+    pthread_mutex_lock(&loc_cfg_lock);
+    if((file = loc_cfg_get_file(conf_file_name, false)) != NULL)
     {
         LOC_LOGD("%s: using %s", __FUNCTION__, conf_file_name);
         if(table_length && config_table) {
-            loc_read_conf_r(conf_fp, config_table, table_length);
-            rewind(conf_fp);
+            loc_cfg_fill_table(file, config_table, table_length);
         }
-        loc_read_conf_r(conf_fp, loc_param_table, loc_param_num);
-        fclose(conf_fp);
+        loc_cfg_fill_table(file, loc_param_table, loc_param_num);
     }
+    pthread_mutex_unlock(&loc_cfg_lock);
+
     /* Initialize logging mechanism with parsed data */
     loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
 }
+
+/* Waits on inotify for the directories of watched files, parses a changed
+   file again and lets its watchers know. */
+class LocCfgWatcher : public LocRunnable {
+    int mFd;
+public:
+    inline LocCfgWatcher(int fd) : LocRunnable(), mFd(fd) {}
+    virtual bool run();
+};
+
+bool LocCfgWatcher::run()
+{
+    char buf[sizeof(struct inotify_event) + NAME_MAX + 1]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len = read(mFd, buf, sizeof(buf));
+
+    if (len < 0) {
+        return (EINTR == errno);
+    }
+
+    for (char* p = buf; p < buf + len; ) {
+        struct inotify_event* event = (struct inotify_event*)p;
+        p += sizeof(struct inotify_event) + event->len;
+
+        if (0 == event->len) {
+            continue;
+        }
+
+        for (loc_cfg_watch_s_type* watch = loc_cfg_watches;
+             NULL != watch; watch = watch->next) {
+            if (watch->wd != event->wd || strcmp(watch->base_name, event->name)) {
+                continue;
+            }
+
+            LOC_LOGI("%s: %s changed", __FUNCTION__, watch->name);
+            pthread_mutex_lock(&loc_cfg_lock);
+            loc_cfg_get_file(watch->name, true);
+            pthread_mutex_unlock(&loc_cfg_lock);
+
+            watch->callback(watch->name, watch->user_data);
+        }
+    }
+
+    return true;
+}
+
+/*===========================================================================
+FUNCTION loc_watch_conf
+
+DESCRIPTION
+   Asks for callback to be called, from a watcher thread, every time the
+   configuration file is written or replaced. By then the file has already
+   been parsed again, so the callback just reads its tables once more with
+   loc_read_conf. Entries taken out of the file keep their current value.
+
+PARAMETERS:
+   conf_file_name: configuration file to watch
+   callback: called with conf_file_name and user_data after a change
+   user_data: passed to callback
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0 on success, -1 on failure
+
+SIDE EFFECTS
+   Starts the watcher thread the first time it is called.
+===========================================================================*/
+int loc_watch_conf(const char* conf_file_name, loc_conf_change_cb callback,
+                   void* user_data)
+{
+    loc_cfg_watch_s_type* watch = NULL;
+    char* slash = NULL;
+    int ret = -1;
+
+    if (NULL == conf_file_name || NULL == callback) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&loc_cfg_lock);
+
+    do {
+        if (loc_cfg_inotify_fd < 0) {
+            int fd = inotify_init();
+            LocThread* thread = NULL;
+
+            if (fd < 0) {
+                LOC_LOGE("%s: inotify_init failed: %s", __FUNCTION__, strerror(errno));
+                break;
+            }
+            thread = new LocThread();
+            if (!thread->start("LocCfgWatcher", new LocCfgWatcher(fd), false)) {
+                LOC_LOGE("%s: could not start watcher thread", __FUNCTION__);
+                delete thread;
+                close(fd);
+                break;
+            }
+            /* the watcher thread lives as long as the process */
+            loc_cfg_inotify_fd = fd;
+        }
+
+        watch = (loc_cfg_watch_s_type*)calloc(1, sizeof(loc_cfg_watch_s_type));
+        if (NULL == watch || NULL == (watch->name = strdup(conf_file_name))) {
+            free(watch);
+            break;
+        }
+
+        /* editors and installers tend to replace the file rather than
+           write it in place, so watch its directory */
+        slash = strrchr(watch->name, '/');
+        if (NULL != slash) {
+            *slash = '\0';
+            watch->wd = inotify_add_watch(loc_cfg_inotify_fd,
+                                          slash == watch->name ? "/" : watch->name,
+                                          IN_CLOSE_WRITE | IN_MOVED_TO);
+            *slash = '/';
+            watch->base_name = slash + 1;
+        } else {
+            watch->wd = inotify_add_watch(loc_cfg_inotify_fd, ".",
+                                          IN_CLOSE_WRITE | IN_MOVED_TO);
+            watch->base_name = watch->name;
+        }
+
+        if (watch->wd < 0) {
+            LOC_LOGE("%s: can not watch %s: %s", __FUNCTION__,
+                     conf_file_name, strerror(errno));
+            free(watch->name);
+            free(watch);
+            break;
+        }
+
+        watch->callback = callback;
+        watch->user_data = user_data;
+        watch->next = loc_cfg_watches;
+        __sync_synchronize();
+        loc_cfg_watches = watch;
+        ret = 0;
+    } while (0);
+
+    pthread_mutex_unlock(&loc_cfg_lock);
+
+    return ret;
+}
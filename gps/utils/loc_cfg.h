@@ -62,6 +62,9 @@ typedef struct
                                                  'f' for float */
 } loc_param_s_type;
 
+/* called from the config watcher thread after a watched file changed */
+typedef void (*loc_conf_change_cb)(const char* conf_file_name, void* user_data);
+
 /*=============================================================================
  *
  *                          MODULE EXTERNAL DATA
@@ -84,6 +87,8 @@ int loc_read_conf_r(FILE *conf_fp, const loc_param_s_type* config_table,
                     uint32_t table_length);
 int loc_update_conf(const char* conf_data, int32_t length,
                     const loc_param_s_type* config_table, uint32_t table_length);
+int loc_watch_conf(const char* conf_file_name, loc_conf_change_cb callback,
+                   void* user_data);
 #ifdef __cplusplus
 }
 #endif
@@ -30,6 +30,9 @@
 #ifndef __LOG_UTIL_H__
 #define __LOG_UTIL_H__
 
+#include <stdint.h>
+#include <time.h>
+
 #ifndef USE_GLIB
 #include <utils/Log.h>
 #endif /* USE_GLIB */
@@ -91,6 +94,48 @@ extern const char EXIT_ERROR_TAG[];
 extern void loc_logger_init(unsigned long debug, unsigned long timestamp);
 extern char* get_timestamp(char* str, unsigned long buf_size);
 
+/* Most verbose level compiled in: 1 E, 2 W, 3 I, 4 D, 5 V. Calls above it
+   compile to nothing, arguments included. User builds clamp DEBUG_LEVEL
+   to 2 at runtime anyway, so they drop I, D and V at build time too. */
+#ifndef LOC_LOG_BUILD_LEVEL
+#ifdef TARGET_BUILD_VARIANT_USER
+#define LOC_LOG_BUILD_LEVEL 2
+#else
+#define LOC_LOG_BUILD_LEVEL 5
+#endif
+#endif /* LOC_LOG_BUILD_LEVEL */
+
+#ifdef __GNUC__
+#define LOC_LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define LOC_LOG_UNLIKELY(x) (x)
+#endif
+
+/* level enabled through DEBUG_LEVEL from gps.conf */
+#define LOC_LOG_ON(level) \
+    ((level) <= LOC_LOG_BUILD_LEVEL && \
+     LOC_LOG_UNLIKELY(loc_logger.DEBUG_LEVEL >= (level) && loc_logger.DEBUG_LEVEL <= 5))
+
+/* DEBUG_LEVEL left at 0xff, Android's log level decides */
+#define LOC_LOG_DEFAULT(level) \
+    ((level) <= LOC_LOG_BUILD_LEVEL && LOC_LOG_UNLIKELY(loc_logger.DEBUG_LEVEL == 0xff))
+
+/* returns nonzero, and restarts the interval, if at least interval_ms
+   passed since *last_ms; racing callers may both log once */
+static inline int loc_log_ratelimit(uint64_t *last_ms, unsigned long interval_ms)
+{
+    struct timespec now;
+    uint64_t now_ms;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ms = (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+    if (*last_ms != 0 && now_ms - *last_ms < interval_ms) {
+        return 0;
+    }
+    *last_ms = now_ms;
+    return 1;
+}
+
 #ifndef DEBUG_DMN_LOC_API
 
 /* LOGGING MACROS */
@@ -98,35 +143,35 @@ extern char* get_timestamp(char* str, unsigned long buf_size);
   if that value remains unchanged, it means gps.conf did not
   provide a value and we default to the initial value to use
   Android's logging levels*/
-#define IF_LOC_LOGE if((loc_logger.DEBUG_LEVEL >= 1) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGE if (LOC_LOG_ON(1))
 
-#define IF_LOC_LOGW if((loc_logger.DEBUG_LEVEL >= 2) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGW if (LOC_LOG_ON(2))
 
-#define IF_LOC_LOGI if((loc_logger.DEBUG_LEVEL >= 3) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGI if (LOC_LOG_ON(3))
 
-#define IF_LOC_LOGD if((loc_logger.DEBUG_LEVEL >= 4) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGD if (LOC_LOG_ON(4))
 
-#define IF_LOC_LOGV if((loc_logger.DEBUG_LEVEL >= 5) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGV if (LOC_LOG_ON(5))
 
 #define LOC_LOGE(...) \
 IF_LOC_LOGE { ALOGE("E/" __VA_ARGS__); } \
-else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGE("E/" __VA_ARGS__); }
+else if (LOC_LOG_DEFAULT(1)) { ALOGE("E/" __VA_ARGS__); }
 
 #define LOC_LOGW(...) \
 IF_LOC_LOGW { ALOGE("W/" __VA_ARGS__); }  \
-else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGW("W/" __VA_ARGS__); }
+else if (LOC_LOG_DEFAULT(2)) { ALOGW("W/" __VA_ARGS__); }
 
 #define LOC_LOGI(...) \
 IF_LOC_LOGI { ALOGE("I/" __VA_ARGS__); }   \
-else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGI("I/" __VA_ARGS__); }
+else if (LOC_LOG_DEFAULT(3)) { ALOGI("I/" __VA_ARGS__); }
 
 #define LOC_LOGD(...) \
 IF_LOC_LOGD { ALOGE("D/" __VA_ARGS__); }   \
-else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGD("D/" __VA_ARGS__); }
+else if (LOC_LOG_DEFAULT(4)) { ALOGD("D/" __VA_ARGS__); }
 
 #define LOC_LOGV(...) \
 IF_LOC_LOGV { ALOGE("V/" __VA_ARGS__); }   \
-else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGV("V/" __VA_ARGS__); }
+else if (LOC_LOG_DEFAULT(5)) { ALOGV("V/" __VA_ARGS__); }
 
 #else /* DEBUG_DMN_LOC_API */
 
@@ -165,6 +210,24 @@ else if (loc_logger.DEBUG_LEVEL == 0xff) { ALOGV("V/" __VA_ARGS__); }
 #define LOC_LOGd(tag,fmt,...) LOC_LOGD(LOC_LOG_HEAD(tag,fmt), __func__, __LINE__, ##__VA_ARGS__)
 #define LOC_LOGe(tag,fmt,...) LOC_LOGE(LOC_LOG_HEAD(tag,fmt), __func__, __LINE__, ##__VA_ARGS__)
 
+/* rate limited variants for messages logged every epoch: each call site
+   logs at most once per interval_ms, and only reads the clock if its
+   level is enabled */
+#define LOC_LOG_RATELIMITED_(LOC_LOG, level, interval_ms, ...)               \
+    do {                                                                      \
+        static uint64_t locLogLastMs_ = 0;                                    \
+        if ((LOC_LOG_ON(level) || LOC_LOG_DEFAULT(level)) &&                  \
+            loc_log_ratelimit(&locLogLastMs_, (interval_ms))) {               \
+            LOC_LOG(__VA_ARGS__);                                             \
+        }                                                                     \
+    } while(0)
+
+#define LOC_LOGE_RL(interval_ms, ...) LOC_LOG_RATELIMITED_(LOC_LOGE, 1, interval_ms, __VA_ARGS__)
+#define LOC_LOGW_RL(interval_ms, ...) LOC_LOG_RATELIMITED_(LOC_LOGW, 2, interval_ms, __VA_ARGS__)
+#define LOC_LOGI_RL(interval_ms, ...) LOC_LOG_RATELIMITED_(LOC_LOGI, 3, interval_ms, __VA_ARGS__)
+#define LOC_LOGD_RL(interval_ms, ...) LOC_LOG_RATELIMITED_(LOC_LOGD, 4, interval_ms, __VA_ARGS__)
+#define LOC_LOGV_RL(interval_ms, ...) LOC_LOG_RATELIMITED_(LOC_LOGV, 5, interval_ms, __VA_ARGS__)
+
 #define LOG_I(ID, WHAT, SPEC, VAL) LOG_(LOC_LOGI, ID, WHAT, SPEC, VAL)
 #define LOG_V(ID, WHAT, SPEC, VAL) LOG_(LOC_LOGV, ID, WHAT, SPEC, VAL)
 #define LOG_E(ID, WHAT, SPEC, VAL) LOG_(LOC_LOGE, ID, WHAT, SPEC, VAL)
@@ -48,6 +48,9 @@ public:
 
     String8 flatten() const;
     void unflatten(const String8 &params);
+    // Like unflatten(params), but only touches keys whose value differs and
+    // returns the keys that were added, changed or removed in changedKeys.
+    void unflatten(const String8 &params, Vector<String8> *changedKeys);
 
     void set(const char *key, const char *value);
     void set(const char *key, int value);
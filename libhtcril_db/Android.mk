@@ -19,6 +19,7 @@ LOCAL_SRC_FILES := \
     htcril_db.c
 
 LOCAL_SHARED_LIBRARIES := libcutils libsqlite
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)
 
 LOCAL_MODULE := libhtcril_db
 LOCAL_MODULE_TAGS := optional
@@ -31,3 +32,12 @@ LOCAL_SRC_FILES := htcril_db_test.c
 LOCAL_MODULE := htcril_db_test
 LOCAL_SHARED_LIBRARIES := libhtcril_db
 include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := htcril_db.c htcril_db_bench.c
+LOCAL_CFLAGS := -DDB_FILENAME=\"/tmp/htcril_db_bench.db\"
+LOCAL_MODULE := htcril_db_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_SHARED_LIBRARIES := liblog libsqlite
+LOCAL_LDLIBS := -lpthread
+include $(BUILD_HOST_EXECUTABLE)
@@ -17,25 +17,255 @@
 #define LOG_TAG  "htcril_db"
 
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include "../../../../external/sqlite/dist/sqlite3.h"
 
 #include "cutils/log.h"
 
+#include "htcril_db.h"
+
 static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
 static int done_init;
 static sqlite3 *handle;
 
+#ifndef DB_FILENAME
 #define DB_FILENAME "/carrier/htcril.db"
+#endif
 #define TABLE_NAME "htcril_properties_table"
 
 #define CREATE_TABLE_SQL \
     "CREATE TABLE IF NOT EXISTS " TABLE_NAME \
        "(property TEXT, value TEXT, PRIMARY KEY(property))"
 
+/* Readers never block the writer and a commit does not fsync the main db */
+#define JOURNAL_SQL "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL"
+
+#define LOAD_SQL "SELECT property, value FROM " TABLE_NAME
+#define SELECT_SQL "SELECT value FROM " TABLE_NAME " WHERE property = ?1"
+#define INSERT_SQL "INSERT OR REPLACE INTO " TABLE_NAME "(property, value) VALUES (?1, ?2)"
+#define VERSION_SQL "PRAGMA data_version"
+
 #define UNUSED __attribute__ ((unused))
 
+/*
+ * Every property in the table is kept in memory from init on, so a get is
+ * a hash lookup. Sets update the cache and are written through to the
+ * database straight away, unless a batch is open, in which case they are
+ * written in one transaction by htcril_db_flush(). Each get and set first
+ * checks PRAGMA data_version and loads the table again when another
+ * process (htcril_db_test, the other RIL instance) has committed to it.
+ * Names that miss the cache are still looked up in the database.
+ */
+#define CACHE_BUCKETS 64
+
+struct cache_entry {
+    struct cache_entry *next;
+    struct cache_entry *dirty_next;
+    unsigned int hash;
+    int dirty;
+    char *value;
+    char name[];
+};
+
+static struct cache_entry *cache[CACHE_BUCKETS];
+static struct cache_entry *dirty_list;
+static int batch_depth;
+static int data_version = -1;
+
+static sqlite3_stmt *select_stmt;
+static sqlite3_stmt *insert_stmt;
+static sqlite3_stmt *version_stmt;
+
+static unsigned int hash_name(const char *name) {
+    /* FNV-1a */
+    unsigned int h = 2166136261u;
+
+    while (*name) {
+        h ^= (unsigned char) *name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static struct cache_entry *cache_find(const char *name, unsigned int hash) {
+    struct cache_entry *e;
+
+    for (e = cache[hash % CACHE_BUCKETS]; e; e = e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static int cache_set_value(struct cache_entry *e, const char *value) {
+    char *copy;
+
+    if (e->value && strcmp(e->value, value) == 0) {
+        return 0;
+    }
+    copy = strdup(value);
+    if (!copy) {
+        return -1;
+    }
+    free(e->value);
+    e->value = copy;
+    return 0;
+}
+
+static struct cache_entry *cache_put(const char *name, const char *value) {
+    unsigned int hash = hash_name(name);
+    struct cache_entry *e = cache_find(name, hash);
+    size_t len;
+
+    if (!e) {
+        len = strlen(name);
+        e = calloc(1, sizeof(*e) + len + 1);
+        if (!e) {
+            return NULL;
+        }
+        memcpy(e->name, name, len + 1);
+        e->hash = hash;
+        e->next = cache[hash % CACHE_BUCKETS];
+        cache[hash % CACHE_BUCKETS] = e;
+    }
+
+    if (cache_set_value(e, value)) {
+        return NULL;
+    }
+    return e;
+}
+
+static void cache_drop(const char *name) {
+    unsigned int hash = hash_name(name);
+    struct cache_entry **pp, *e;
+
+    for (pp = &cache[hash % CACHE_BUCKETS]; (e = *pp) != NULL; pp = &e->next) {
+        if (e->hash == hash && strcmp(e->name, name) == 0) {
+            if (!e->dirty) {
+                *pp = e->next;
+                free(e->value);
+                free(e);
+            }
+            return;
+        }
+    }
+}
+
+static void cache_clear(void) {
+    struct cache_entry *e, *next;
+    int i;
+
+    for (i = 0; i < CACHE_BUCKETS; i++) {
+        for (e = cache[i]; e; e = next) {
+            next = e->next;
+            free(e->value);
+            free(e);
+        }
+        cache[i] = NULL;
+    }
+    dirty_list = NULL;
+}
+
+/* Drops everything but the values a batch has yet to write */
+static void cache_drop_clean(void) {
+    struct cache_entry **pp, *e;
+    int i;
+
+    for (i = 0; i < CACHE_BUCKETS; i++) {
+        pp = &cache[i];
+        while ((e = *pp) != NULL) {
+            if (e->dirty) {
+                pp = &e->next;
+            } else {
+                *pp = e->next;
+                free(e->value);
+                free(e);
+            }
+        }
+    }
+}
+
+static int cache_load_locked(void) {
+    sqlite3_stmt *stmt;
+    int rc;
+
+    if (sqlite3_prepare_v2(handle, LOAD_SQL, -1, &stmt, NULL) != SQLITE_OK) {
+        ALOGE("failed to prepare sql [%s]: %s", LOAD_SQL, sqlite3_errmsg(handle));
+        return -1;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        const char *name = (const char *) sqlite3_column_text(stmt, 0);
+        const char *value = (const char *) sqlite3_column_text(stmt, 1);
+
+        struct cache_entry *e;
+
+        if (!name) {
+            continue;
+        }
+        /* A value a batch has yet to write wins over the database */
+        e = cache_find(name, hash_name(name));
+        if (e && e->dirty) {
+            continue;
+        }
+        if (!cache_put(name, value ? value : "")) {
+            rc = SQLITE_NOMEM;
+            break;
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_DONE) {
+        ALOGE("failed to load %s: %d", TABLE_NAME, rc);
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Only changes when another connection commits to the database */
+static int db_data_version_locked(void) {
+    int version = -1;
+
+    if (sqlite3_step(version_stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(version_stmt, 0);
+    }
+    sqlite3_reset(version_stmt);
+
+    return version;
+}
+
+static void cache_refresh_locked(void) {
+    int version = db_data_version_locked();
+
+    if (version >= 0 && version == data_version) {
+        return;
+    }
+
+    cache_drop_clean();
+    /* On failure, names missing from the cache are read from the database */
+    data_version = cache_load_locked() ? -1 : version;
+}
+
+static int db_close_locked(void) {
+    int ret;
+
+    sqlite3_finalize(select_stmt);
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(version_stmt);
+    select_stmt = NULL;
+    insert_stmt = NULL;
+    version_stmt = NULL;
+    data_version = -1;
+    ret = sqlite3_close(handle);
+    handle = NULL;
+    sqlite3_shutdown();
+    return ret;
+}
+
 static int db_init_locked(void) {
     char *error_str = NULL;
 
@@ -50,16 +280,39 @@ static int db_init_locked(void) {
 
     if (sqlite3_open(DB_FILENAME, &handle)) {
         ALOGE("failed to open %s", DB_FILENAME);
+        sqlite3_close(handle);
+        handle = NULL;
         sqlite3_shutdown();
         return -1;
     }
 
+    /* Not fatal: the default rollback journal still works */
+    if (sqlite3_exec(handle, JOURNAL_SQL, NULL, NULL, &error_str)) {
+        ALOGW("failed to exec sql [%s]: %s", JOURNAL_SQL, error_str);
+        sqlite3_free(error_str);
+        error_str = NULL;
+    }
+
     ALOGV("execute: %s", CREATE_TABLE_SQL);
     if (sqlite3_exec(handle, CREATE_TABLE_SQL, NULL, NULL, &error_str)) {
         ALOGE("failed to exec sql [%s]: %s", CREATE_TABLE_SQL, error_str);
         sqlite3_free(error_str);
-        sqlite3_close(handle);
-        sqlite3_shutdown();
+        db_close_locked();
+        return -1;
+    }
+
+    if (sqlite3_prepare_v2(handle, SELECT_SQL, -1, &select_stmt, NULL) != SQLITE_OK ||
+            sqlite3_prepare_v2(handle, INSERT_SQL, -1, &insert_stmt, NULL) != SQLITE_OK ||
+            sqlite3_prepare_v2(handle, VERSION_SQL, -1, &version_stmt, NULL) != SQLITE_OK) {
+        ALOGE("failed to prepare statements: %s", sqlite3_errmsg(handle));
+        db_close_locked();
+        return -1;
+    }
+
+    data_version = db_data_version_locked();
+    if (cache_load_locked()) {
+        cache_clear();
+        db_close_locked();
         return -1;
     }
 
@@ -78,23 +331,94 @@ int htcril_db_init(void) {
     return ret;
 }
 
-static int get_cb(void *result, int argc UNUSED, char **argv, char **column UNUSED) {
-    strcpy(result, argv[0]);
+static int db_write_locked(const char *name, const char *value) {
+    int rc;
+
+    sqlite3_bind_text(insert_stmt, 1, name, -1, SQLITE_STATIC);
+    sqlite3_bind_text(insert_stmt, 2, value, -1, SQLITE_STATIC);
+    rc = sqlite3_step(insert_stmt);
+    sqlite3_reset(insert_stmt);
+    sqlite3_clear_bindings(insert_stmt);
+
+    if (rc != SQLITE_DONE) {
+        ALOGE("failed to write %s=%s: %s", name, value, sqlite3_errmsg(handle));
+        return -1;
+    }
+
     return 0;
 }
 
-static int db_property_get_locked(const char *name, char *value_ret, const char *def_value) {
-    char sql[400];
+static int db_flush_locked(void) {
+    struct cache_entry *e;
     char *error_str = NULL;
+    int ret = 0;
+
+    if (!dirty_list) {
+        return 0;
+    }
+
+    if (sqlite3_exec(handle, "BEGIN IMMEDIATE", NULL, NULL, &error_str)) {
+        ALOGE("failed to begin transaction: %s", error_str);
+        sqlite3_free(error_str);
+        return -1;
+    }
+
+    for (e = dirty_list; e; e = e->dirty_next) {
+        if (db_write_locked(e->name, e->value)) {
+            ret = -1;
+            break;
+        }
+    }
+
+    if (ret || sqlite3_exec(handle, "COMMIT", NULL, NULL, &error_str)) {
+        if (error_str) {
+            ALOGE("failed to commit transaction: %s", error_str);
+            sqlite3_free(error_str);
+        }
+        /* Keep the entries dirty so the next flush retries them */
+        sqlite3_exec(handle, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+
+    while ((e = dirty_list) != NULL) {
+        dirty_list = e->dirty_next;
+        e->dirty_next = NULL;
+        e->dirty = 0;
+    }
+
+    return 0;
+}
+
+static int db_property_get_locked(const char *name, char *value_ret, const char *def_value) {
+    struct cache_entry *e;
+    const char *value;
+    int rc;
+
+    cache_refresh_locked();
+
+    e = cache_find(name, hash_name(name));
+    if (e) {
+        strcpy(value_ret, e->value[0] ? e->value : def_value);
+        return 0;
+    }
 
     value_ret[0] = '\0';
 
-    snprintf(sql, sizeof(sql), "SELECT value FROM " TABLE_NAME " WHERE property = '%s'", name);
+    sqlite3_bind_text(select_stmt, 1, name, -1, SQLITE_STATIC);
+    rc = sqlite3_step(select_stmt);
+    if (rc == SQLITE_ROW) {
+        value = (const char *) sqlite3_column_text(select_stmt, 0);
+        if (value) {
+            strcpy(value_ret, value);
+            cache_put(name, value);
+        }
+        rc = SQLITE_DONE;
+    }
+    sqlite3_reset(select_stmt);
+    sqlite3_clear_bindings(select_stmt);
 
-    ALOGV("execute: %s", sql);
-    if (sqlite3_exec(handle, sql, get_cb, value_ret, &error_str)) {
-        ALOGE("failed to execute sql [%s]: %s", sql, error_str);
-        sqlite3_free(error_str);
+    if (rc != SQLITE_DONE) {
+        ALOGE("failed to read %s: %s", name, sqlite3_errmsg(handle));
         return -1;
     }
 
@@ -118,19 +442,36 @@ int htcril_db_property_get(const char *name, char *value_ret, const char *def_va
 }
 
 static int db_property_set_locked(const char *name, const char *value) {
-    char sql[400];
-    char *error_str = NULL;
+    struct cache_entry *e;
 
-    snprintf(sql, sizeof(sql),
-        "INSERT OR REPLACE INTO " TABLE_NAME "(property, value) VALUES ('%s', '%s')",
-        name, value);
+    cache_refresh_locked();
 
-    ALOGV("execute: %s", sql);
-    if (sqlite3_exec(handle, sql, NULL, NULL, &error_str)) {
-        ALOGE("Failed to exec sql [%s]: %s", sql, error_str);
-        sqlite3_free(error_str);
+    e = cache_find(name, hash_name(name));
+    if (e && !e->dirty && strcmp(e->value, value) == 0) {
+        return 0;
+    }
+
+    if (!batch_depth) {
+        if (db_write_locked(name, value)) {
+            return -1;
+        }
+        if (!cache_put(name, value)) {
+            /* The database has it; drop the stale copy so a get reads it back */
+            cache_drop(name);
+        }
+        return 0;
+    }
+
+    e = cache_put(name, value);
+    if (!e) {
+        ALOGE("failed to cache %s", name);
         return -1;
     }
+    if (!e->dirty) {
+        e->dirty = 1;
+        e->dirty_next = dirty_list;
+        dirty_list = e;
+    }
 
     return 0;
 }
@@ -147,15 +488,54 @@ int htcril_db_property_set(const char *name, const char *value) {
     return ret;
 }
 
-static int db_reset_cleanup_locked(void) {
+int htcril_db_batch_begin(void) {
     int ret;
 
+    pthread_mutex_lock(&lock);
+    if ((ret = db_init_locked()) == 0) {
+        batch_depth++;
+    }
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+}
+
+int htcril_db_batch_end(void) {
+    int ret = 0;
+
+    pthread_mutex_lock(&lock);
+    if (batch_depth > 0 && --batch_depth == 0 && done_init) {
+        ret = db_flush_locked();
+    }
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+}
+
+int htcril_db_flush(void) {
+    int ret = 0;
+
+    pthread_mutex_lock(&lock);
+    if (done_init) {
+        ret = db_flush_locked();
+    }
+    pthread_mutex_unlock(&lock);
+
+    return ret;
+}
+
+static int db_reset_cleanup_locked(void) {
+    int flush_ret, ret;
+
     if (!done_init) {
         return 0;
     }
-    ret = sqlite3_close(handle);
-    sqlite3_shutdown();
-    return ret;
+    flush_ret = db_flush_locked();
+    cache_clear();
+    batch_depth = 0;
+    ret = db_close_locked();
+    done_init = 0;
+    return ret ? ret : flush_ret;
 }
 
 int htcril_db_reset_cleanup(void) {
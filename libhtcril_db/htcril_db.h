@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HTCRIL_DB_H
+#define HTCRIL_DB_H
+
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * Key/value properties of the HTC RIL, kept in /carrier/htcril.db. The
+ * prebuilt RIL calls the get, set and reset functions; every function
+ * opens the database on first use and returns 0 on success, -1 on error.
+ */
+
+int htcril_db_init(void);
+
+/*
+ * Copies the value of name, or def_value if it is not set or empty, to
+ * value_ret, which must be large enough for either.
+ */
+int htcril_db_property_get(const char *name, char *value_ret, const char *def_value);
+
+/* Written to the database before it returns, unless a batch is open */
+int htcril_db_property_set(const char *name, const char *value);
+
+/*
+ * Holds property sets back until the outermost htcril_db_batch_end() or
+ * htcril_db_flush(), which write all of them in one transaction: either
+ * every set of the batch reaches the database or none does. Gets see the
+ * values set in the batch straight away. Batches nest.
+ */
+int htcril_db_batch_begin(void);
+int htcril_db_batch_end(void);
+
+/* Writes the sets held back by an open batch now; the batch stays open */
+int htcril_db_flush(void);
+
+/* Writes pending sets and closes the database */
+int htcril_db_reset_cleanup(void);
+
+__END_DECLS
+
+#endif // HTCRIL_DB_H
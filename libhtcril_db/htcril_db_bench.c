@@ -0,0 +1,376 @@
+/*
+ * Copyright (C) 2016 The CyanogenMod Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host benchmark and stress test for libhtcril_db.
+ *
+ * Built with htcril_db.c and DB_FILENAME pointing at a scratch file, which
+ * is deleted and recreated by each test. Reports get/set throughput and
+ * latency percentiles for 1 to 16 threads against a warm and a cold
+ * cache, then forks writers that are killed in the middle of a batch and
+ * checks the database they leave behind.
+ *
+ * usage: htcril_db_bench [ops_per_thread] [crash_rounds]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../../../../external/sqlite/dist/sqlite3.h"
+
+#include "htcril_db.h"
+
+#ifndef DB_FILENAME
+#error DB_FILENAME must name a scratch database
+#endif
+
+#define NUM_KEYS       64
+#define MAX_THREADS    16
+#define CRASH_KEYS     24   /* one batch, so one transaction */
+#define VALUE_LEN      400
+
+enum op_type {
+    OP_GET,
+    OP_SET,
+    OP_MISS,
+};
+
+struct worker {
+    pthread_t thread;
+    enum op_type op;
+    int id;
+    int ops;
+    int errors;
+    unsigned int *lat_ns;
+};
+
+static char key_names[NUM_KEYS][32];
+static pthread_barrier_t start_barrier;
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void remove_db(void) {
+    unlink(DB_FILENAME);
+    unlink(DB_FILENAME "-wal");
+    unlink(DB_FILENAME "-shm");
+    unlink(DB_FILENAME "-journal");
+}
+
+static int populate(void) {
+    char value[32];
+    int i;
+
+    htcril_db_batch_begin();
+    for (i = 0; i < NUM_KEYS; i++) {
+        snprintf(value, sizeof(value), "value%d", i);
+        if (htcril_db_property_set(key_names[i], value)) {
+            htcril_db_batch_end();
+            return -1;
+        }
+    }
+    return htcril_db_batch_end();
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = arg;
+    char value[VALUE_LEN];
+    char miss[32];
+    unsigned long long start;
+    unsigned int seed = w->id;
+    int i, k, ret;
+
+    pthread_barrier_wait(&start_barrier);
+
+    for (i = 0; i < w->ops; i++) {
+        k = rand_r(&seed) % NUM_KEYS;
+        start = now_ns();
+        switch (w->op) {
+        case OP_GET:
+            ret = htcril_db_property_get(key_names[k], value, "def");
+            break;
+        case OP_SET:
+            snprintf(value, sizeof(value), "%d.%d", w->id, i);
+            start = now_ns();
+            ret = htcril_db_property_set(key_names[k], value);
+            break;
+        default:
+            snprintf(miss, sizeof(miss), "bench.absent.%d", k);
+            start = now_ns();
+            ret = htcril_db_property_get(miss, value, "def");
+            break;
+        }
+        w->lat_ns[i] = (unsigned int) (now_ns() - start);
+        if (ret) {
+            w->errors++;
+        }
+    }
+
+    return NULL;
+}
+
+static int cmp_uint(const void *a, const void *b) {
+    unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, int threads, int total, unsigned long long elapsed_ns,
+        unsigned int *lat, int errors) {
+    qsort(lat, total, sizeof(*lat), cmp_uint);
+    printf("%-10s %3d %10.0f %9.2f %9.2f %9.2f %9.2f %6d\n",
+            name, threads, total * 1e9 / elapsed_ns,
+            lat[total / 2] / 1000.0,
+            lat[(int) (total * 0.99)] / 1000.0,
+            lat[(int) (total * 0.999)] / 1000.0,
+            lat[total - 1] / 1000.0,
+            errors);
+}
+
+static int run_threads(const char *name, enum op_type op, int threads, int ops,
+        int cold) {
+    struct worker workers[MAX_THREADS];
+    unsigned int *lat;
+    unsigned long long start;
+    int i, errors = 0;
+
+    lat = malloc(sizeof(*lat) * threads * ops);
+    if (!lat) {
+        return -1;
+    }
+
+    if (cold) {
+        /* Next call reopens the database and reloads the cache */
+        htcril_db_reset_cleanup();
+    }
+
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (i = 0; i < threads; i++) {
+        workers[i].op = op;
+        workers[i].id = i + 1;
+        workers[i].ops = ops;
+        workers[i].errors = 0;
+        workers[i].lat_ns = lat + i * ops;
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    start = now_ns();
+    pthread_barrier_wait(&start_barrier);
+    for (i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        errors += workers[i].errors;
+    }
+    report(name, threads, threads * ops, now_ns() - start, lat, errors);
+
+    pthread_barrier_destroy(&start_barrier);
+    free(lat);
+    return errors ? -1 : 0;
+}
+
+/* First get after init: opens the database and loads the whole table */
+static int run_cold_open(int rounds) {
+    char value[VALUE_LEN];
+    unsigned int *lat;
+    unsigned long long start, total_start;
+    int i, errors = 0;
+
+    lat = malloc(sizeof(*lat) * rounds);
+    if (!lat) {
+        return -1;
+    }
+
+    total_start = now_ns();
+    for (i = 0; i < rounds; i++) {
+        htcril_db_reset_cleanup();
+        start = now_ns();
+        if (htcril_db_property_get(key_names[i % NUM_KEYS], value, "def")) {
+            errors++;
+        }
+        lat[i] = (unsigned int) (now_ns() - start);
+    }
+    report("cold-open", 1, rounds, now_ns() - total_start, lat, errors);
+
+    free(lat);
+    return errors ? -1 : 0;
+}
+
+static int run_benchmarks(int ops) {
+    static const int thread_counts[] = { 1, 2, 4, 8, 16 };
+    unsigned int n;
+    int ret = 0;
+
+    remove_db();
+    if (htcril_db_init() || populate()) {
+        fprintf(stderr, "failed to create %s\n", DB_FILENAME);
+        return -1;
+    }
+
+    printf("%-10s %3s %10s %9s %9s %9s %9s %6s\n",
+            "test", "thr", "ops/s", "p50(us)", "p99(us)", "p99.9(us)", "max(us)", "errors");
+
+    ret |= run_cold_open(ops / 10 > 0 ? ops / 10 : 1);
+
+    for (n = 0; n < sizeof(thread_counts) / sizeof(thread_counts[0]); n++) {
+        /* each thread's first NUM_KEYS gets after the database is reopened */
+        ret |= run_threads("get-cold", OP_GET, thread_counts[n], NUM_KEYS, 1);
+        ret |= run_threads("get-warm", OP_GET, thread_counts[n], ops, 0);
+        ret |= run_threads("get-miss", OP_MISS, thread_counts[n], ops, 0);
+        ret |= run_threads("set", OP_SET, thread_counts[n], ops / 10 > 0 ? ops / 10 : 1, 0);
+    }
+
+    htcril_db_reset_cleanup();
+    return ret;
+}
+
+/*
+ * The child writes generation g of every crash.* key in one batch, over
+ * and over, starting after the last generation that survived, until the
+ * parent kills it. Each batch is a single transaction, so whatever is left
+ * must be one complete generation, and never an older one.
+ */
+static void crash_writer(unsigned int gen) {
+    char name[32], value[32];
+    int i;
+
+    for (; ; gen++) {
+        htcril_db_batch_begin();
+        for (i = 0; i < CRASH_KEYS; i++) {
+            snprintf(name, sizeof(name), "crash.%d", i);
+            snprintf(value, sizeof(value), "%u", gen);
+            htcril_db_property_set(name, value);
+        }
+        htcril_db_batch_end();
+    }
+}
+
+static int verify_db(unsigned int *gen_ret) {
+    sqlite3 *db;
+    sqlite3_stmt *stmt;
+    const char *text;
+    int rows = 0, gens = 0, ok = 0;
+
+    if (sqlite3_open(DB_FILENAME, &db)) {
+        fprintf(stderr, "failed to open %s after crash\n", DB_FILENAME);
+        sqlite3_close(db);
+        return -1;
+    }
+
+    if (sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            text = (const char *) sqlite3_column_text(stmt, 0);
+            ok = text && strcmp(text, "ok") == 0;
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (!ok) {
+        fprintf(stderr, "integrity_check failed\n");
+        sqlite3_close(db);
+        return -1;
+    }
+
+    if (sqlite3_prepare_v2(db,
+            "SELECT COUNT(*), COUNT(DISTINCT value), MAX(CAST(value AS INTEGER)) "
+            "FROM htcril_properties_table WHERE property LIKE 'crash.%'",
+            -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            rows = sqlite3_column_int(stmt, 0);
+            gens = sqlite3_column_int(stmt, 1);
+            *gen_ret = (unsigned int) sqlite3_column_int(stmt, 2);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(db);
+
+    /* Nothing committed yet is fine; a partial batch is not */
+    if (rows == 0) {
+        *gen_ret = 0;
+        return 0;
+    }
+    if (rows != CRASH_KEYS || gens != 1) {
+        fprintf(stderr, "torn batch: %d rows, %d generations\n", rows, gens);
+        return -1;
+    }
+    return 0;
+}
+
+static int run_crash_test(int rounds) {
+    unsigned int gen = 0, last_gen = 0;
+    unsigned int seed = (unsigned int) now_ns();
+    pid_t pid;
+    int i, status, failures = 0;
+
+    remove_db();
+
+    for (i = 0; i < rounds; i++) {
+        pid = fork();
+        if (pid < 0) {
+            fprintf(stderr, "fork failed: %s\n", strerror(errno));
+            return -1;
+        }
+        if (pid == 0) {
+            crash_writer(last_gen + 1);
+            _exit(0);
+        }
+
+        usleep(1000 + rand_r(&seed) % 20000);
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+
+        if (verify_db(&gen)) {
+            failures++;
+        } else if (gen < last_gen) {
+            fprintf(stderr, "generation went back from %u to %u\n", last_gen, gen);
+            failures++;
+        }
+        last_gen = gen;
+    }
+
+    printf("crash      %d rounds, last generation %u, %d failures\n",
+            rounds, last_gen, failures);
+    return failures ? -1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int ops = argc > 1 ? atoi(argv[1]) : 20000;
+    int rounds = argc > 2 ? atoi(argv[2]) : 50;
+    int ret = 0;
+    int i;
+
+    if (ops <= 0 || rounds < 0) {
+        fprintf(stderr, "usage: %s [ops_per_thread] [crash_rounds]\n", argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < NUM_KEYS; i++) {
+        snprintf(key_names[i], sizeof(key_names[i]), "persist.radio.bench%d", i);
+    }
+
+    ret |= run_benchmarks(ops);
+    ret |= run_crash_test(rounds);
+
+    remove_db();
+    return ret ? 1 : 0;
+}
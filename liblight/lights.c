@@ -51,38 +51,86 @@ static struct light_state_t g_battery;
 
 static bool write_led_error = false;
 
-const char *const INDICATOR_LED_FILE = "/sys/class/leds/indicator/mode_and_lut_params";
-const char *const BUTTON_BACKLIGHT_FILE = "/sys/class/leds/button-backlight/brightness";
-const char *const LCD_BACKLIGHT_FILE = "/sys/class/leds/lcd-backlight/brightness";
-
-static int write_file_string(const char *path, const char *value) {
+/*
+ * A sysfs node kept open between writes. With dedupe set, the last value
+ * written is remembered so that repeating it does not cost a syscall.
+ * The LCD backlight is always written: the display driver sets it on
+ * its own across panel power changes, so the last value we wrote says
+ * nothing about what the panel shows.
+ */
+struct sysfs_node {
+    const char *path;
+    bool dedupe;
     int fd;
+    bool valid;
+    char last[100];
+};
+
+static struct sysfs_node g_indicator_led = {
+    "/sys/class/leds/indicator/mode_and_lut_params", true, -1, false, "" };
+static struct sysfs_node g_button_backlight = {
+    "/sys/class/leds/button-backlight/brightness", true, -1, false, "" };
+static struct sysfs_node g_lcd_backlight = {
+    "/sys/class/leds/lcd-backlight/brightness", false, -1, false, "" };
+
+/*
+ * Backlight updates are handed to a writer thread, which always writes
+ * the latest one; a ramp that outpaces the sysfs write is coalesced
+ * instead of queued on the caller's thread.
+ */
+static pthread_mutex_t g_backlight_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_backlight_cond = PTHREAD_COND_INITIALIZER;
+static bool g_backlight_thread_running = false;
+static bool g_backlight_pending = false;
+static uint32_t g_backlight_value;
+static int g_backlight_rc = 0;
+
+static int write_node_string(struct sysfs_node *node, const char *value) {
     int rc = 0;
-    int bytes, written;
-    fd = open(path, O_RDWR);
-    if (fd < 0) {
-        rc = -errno;
-        if (!write_led_error) {
-            ALOGE("%s: failed to open %s\n", __func__, path);
-            write_led_error = true;
+    ssize_t written;
+    size_t len = strlen(value);
+
+    if (node->valid && strcmp(node->last, value) == 0) {
+        return 0;
+    }
+
+    if (node->fd < 0) {
+        node->fd = open(node->path, O_RDWR | O_CLOEXEC);
+        if (node->fd < 0) {
+            rc = -errno;
+            if (!write_led_error) {
+                ALOGE("%s: failed to open %s\n", __func__, node->path);
+                write_led_error = true;
+            }
+            return rc;
         }
-        return rc;
     }
 
-    written = write(fd, value, strlen(value));
+    written = pwrite(node->fd, value, len, 0);
     if (written < 0) {
         rc = -errno;
         ALOGE("%s: failed to write %s\n", __func__, value);
+        /* Reopen next time in case the node went away */
+        close(node->fd);
+        node->fd = -1;
+        node->valid = false;
+        return rc;
+    }
+
+    if (node->dedupe && len < sizeof(node->last)) {
+        memcpy(node->last, value, len + 1);
+        node->valid = true;
+    } else {
+        node->valid = false;
     }
-    close(fd);
     return rc;
 }
 
-static int write_file(const char *path, const char *format, uint32_t value) {
+static int write_node(struct sysfs_node *node, const char *format, uint32_t value) {
     char buffer[20];
 
     snprintf(buffer, sizeof(buffer), format, value);
-    return write_file_string(path, buffer);
+    return write_node_string(node, buffer);
 }
 
 static int write_led(uint32_t mode_rgb, uint32_t on_ms, uint32_t off_ms)
@@ -91,17 +139,42 @@ static int write_led(uint32_t mode_rgb, uint32_t on_ms, uint32_t off_ms)
 
     /* Scale this down because we can only flash quickly */
     sprintf(buf, "%x %u %u 0", mode_rgb, on_ms / 4, off_ms / 4);
-    return write_file_string(INDICATOR_LED_FILE, buf);
+    return write_node_string(&g_indicator_led, buf);
 }
 
 static int write_button(uint32_t value) {
     /* button backlight expects a decimal number */
-    return write_file(BUTTON_BACKLIGHT_FILE, "%d", value);
+    return write_node(&g_button_backlight, "%d", value);
 }
 
 static int write_backlight(uint32_t value) {
     /* backlight expects a decimal number */
-    return write_file(LCD_BACKLIGHT_FILE, "%d", value);
+    return write_node(&g_lcd_backlight, "%d", value);
+}
+
+static void *backlight_writer(UNUSED void *arg) {
+    uint32_t brightness;
+    int rc;
+
+    pthread_mutex_lock(&g_backlight_lock);
+    for (;;) {
+        while (!g_backlight_pending) {
+            pthread_cond_wait(&g_backlight_cond, &g_backlight_lock);
+        }
+        brightness = g_backlight_value;
+        g_backlight_pending = false;
+        pthread_mutex_unlock(&g_backlight_lock);
+
+        rc = write_backlight(brightness);
+        if (rc < 0 && !write_led_error) {
+            ALOGE("%s: Failed to set backlight brightness to 0x%08x\n",
+                    __func__, brightness);
+        }
+
+        pthread_mutex_lock(&g_backlight_lock);
+        g_backlight_rc = rc;
+    }
+    return NULL;
 }
 
 static uint32_t rgb_to_brightness(const struct light_state_t *state) {
@@ -115,7 +188,20 @@ static bool is_lit(const struct light_state_t *state) {
 }
 
 void init_globals(void) {
+    pthread_attr_t attr;
+    pthread_t thread;
+
     pthread_mutex_init(&g_lock, NULL);
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, backlight_writer, NULL) == 0) {
+        pthread_setname_np(thread, "lights_backlight");
+        g_backlight_thread_running = true;
+    } else {
+        ALOGE("%s: failed to start backlight writer, writing inline", __func__);
+    }
+    pthread_attr_destroy(&attr);
 }
 
 static void set_speaker_light_locked(UNUSED struct light_device_t *dev,
@@ -210,16 +296,25 @@ static int set_light_backlight(UNUSED struct light_device_t *dev,
 
     ALOGV("%s: brightness: 0x%08x", __func__, brightness);
 
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&g_backlight_lock);
 
-    rc = write_backlight(brightness);
-    if (rc < 0) {
-        if (!write_led_error) {
-            ALOGE("%s: Failed to set backlight brightness to 0x%08x\n",
-                    __func__, brightness);
+    if (g_backlight_thread_running) {
+        /* Report the outcome of the previous write */
+        g_backlight_value = brightness;
+        g_backlight_pending = true;
+        pthread_cond_signal(&g_backlight_cond);
+        rc = g_backlight_rc;
+    } else {
+        rc = write_backlight(brightness);
+        if (rc < 0) {
+            if (!write_led_error) {
+                ALOGE("%s: Failed to set backlight brightness to 0x%08x\n",
+                        __func__, brightness);
+            }
         }
     }
-    pthread_mutex_unlock(&g_lock);
+
+    pthread_mutex_unlock(&g_backlight_lock);
 
     return rc;
 }
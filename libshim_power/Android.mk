@@ -18,6 +18,9 @@ include $(CLEAR_VARS)
 LOCAL_SRC_FILES := \
     perf.c
 
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../thermal
+LOCAL_SHARED_LIBRARIES := libdl libhardware liblog
+
 LOCAL_MODULE := libshim_power
 LOCAL_MODULE_TAGS := optional
 LOCAL_MODULE_CLASS := SHARED_LIBRARIES
@@ -14,12 +14,490 @@
  * limitations under the License.
  */
 
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LOG_TAG "PerfShim"
+#include <cutils/log.h>
+
+#include <hardware/hardware.h>
+
+#include "thermal_trend.h"
+
+// Seconds before a predicted throttle at which boosts start backing off.
+#define THERMAL_BACKOFF_WINDOW_S 30.0f
+// More trends than the HAL reports are ignored.
+#define THERMAL_MAX_TRENDS 16
+
+#ifndef PERF_PROFILE_FILE
+#define PERF_PROFILE_FILE "/system/vendor/etc/perf_lock.conf"
+#endif
+#ifndef CPU_SYSFS_DIR
+#define CPU_SYSFS_DIR "/sys/devices/system/cpu"
+#endif
+// Most sysfs nodes a profile can boost.
+#define PERF_MAX_NODES 16
+#define PERF_VALUE_LEN 64
+// A perf lock still held after this long is assumed leaked and dropped.
+#define PERF_DEFAULT_MAX_HOLD_MS 10000
+// Perf locks whose age is tracked; more share the newest one's time.
+#define PERF_MAX_LOCKS 32
+// Boost sessions between hold time summaries in the log.
+#define PERF_STATS_INTERVAL 64
+// Upper bounds (ms) of the hold time histogram buckets; the last is open.
+static const int64_t hold_buckets_ms[] = { 50, 200, 1000, 5000 };
+#define PERF_HOLD_BUCKETS (sizeof(hold_buckets_ms) / sizeof(hold_buckets_ms[0]) + 1)
+
+struct perf_node {
+    char path[PATH_MAX];
+    char boost[PERF_VALUE_LEN];
+    char saved[PERF_VALUE_LEN];
+    // What the node read back right after our write, which the kernel may
+    // have clamped, and for frequency floors the floor we asked for.
+    char written[PERF_VALUE_LEN];
+    long long written_floor;
+    // Frequency floors shrink with thermal headroom; other hints do not.
+    int scaled;
+    int applied;
+    // Set once a write failed, so a node we may not write is logged once.
+    int write_failed;
+};
+
+static pthread_once_t thermal_once = PTHREAD_ONCE_INIT;
+static thermal_get_temperature_trends_t get_temperature_trends;
+
+static pthread_once_t perf_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t perf_cond;
+static struct perf_node perf_nodes[PERF_MAX_NODES];
+static int perf_node_count;
+static int64_t perf_max_hold_ns = PERF_DEFAULT_MAX_HOLD_MS * 1000000LL;
+static int perf_watchdog_running;
+
+// All below are protected by perf_lock.
+static int perf_refs;
+static int perf_peak_refs;
+static int64_t perf_boost_start_ns;
+// Acquire times of the held locks, oldest first. A release retires the
+// newest, so one lock its holder never releases keeps its age.
+static int64_t perf_acquire_ns[PERF_MAX_LOCKS];
+
+static struct {
+    uint32_t sessions;
+    uint32_t expired;
+    int64_t total_ms;
+    int64_t max_ms;
+    uint32_t buckets[PERF_HOLD_BUCKETS];
+} perf_stats;
+
+static void thermal_init(void)
+{
+    const hw_module_t *module;
+
+    if (hw_get_module(THERMAL_HARDWARE_MODULE_ID, &module) != 0 || module->dso == NULL) {
+        ALOGW("%s: no thermal HAL, boosting without thermal backoff", __func__);
+        return;
+    }
+
+    get_temperature_trends = (thermal_get_temperature_trends_t)
+            dlsym(module->dso, THERMAL_TREND_SYMBOL);
+    if (get_temperature_trends == NULL)
+        ALOGW("%s: thermal HAL has no trends, boosting without thermal backoff", __func__);
+}
+
+/*
+ * Percentage of a full boost the CPU and skin temperatures leave room
+ * for: 100 while no sensor is heading for its threshold, falling to 0 as
+ * the predicted time to reach it shrinks through the backoff window.
+ */
+static int thermal_headroom(void)
+{
+    temperature_trend_t trends[THERMAL_MAX_TRENDS];
+    float headroom = 100.0f;
+    ssize_t count, i;
+
+    pthread_once(&thermal_once, thermal_init);
+    if (get_temperature_trends == NULL)
+        return 100;
+
+    count = get_temperature_trends(trends, THERMAL_MAX_TRENDS);
+    if (count < 0)
+        return 100;
+    if (count > THERMAL_MAX_TRENDS)
+        count = THERMAL_MAX_TRENDS;
+
+    for (i = 0; i < count; i++) {
+        float room;
+
+        if (trends[i].type != DEVICE_TEMPERATURE_CPU &&
+                trends[i].type != DEVICE_TEMPERATURE_SKIN)
+            continue;
+        if (trends[i].time_to_threshold < 0)
+            continue;
+
+        room = trends[i].time_to_threshold * 100.0f / THERMAL_BACKOFF_WINDOW_S;
+        if (room < headroom)
+            headroom = room;
+    }
+
+    return (int)headroom;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int read_node(const char *path, char *buf, size_t size)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    ssize_t len;
+
+    if (fd < 0)
+        return -errno;
+
+    len = read(fd, buf, size - 1);
+    close(fd);
+    if (len < 0)
+        return -errno;
+
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == ' '))
+        len--;
+    buf[len] = '\0';
+    return 0;
+}
+
+static int write_node(struct perf_node *node, const char *value)
+{
+    int fd = open(node->path, O_WRONLY | O_CLOEXEC);
+    size_t len = strlen(value);
+    ssize_t written;
+    int err = 0;
+
+    if (fd < 0) {
+        err = errno;
+    } else {
+        written = write(fd, value, len);
+        if (written != (ssize_t)len)
+            err = written < 0 ? errno : EIO;
+        close(fd);
+    }
+
+    if (err != 0 && !node->write_failed) {
+        ALOGE("%s: failed to write %s to %s: %s", __func__, value, node->path,
+                strerror(err));
+        node->write_failed = 1;
+    }
+    return -err;
+}
+
+static void add_node(const char *path, const char *value, int scaled)
+{
+    struct perf_node *node;
+
+    if (perf_node_count == PERF_MAX_NODES) {
+        ALOGE("%s: too many entries, ignoring %s", __func__, path);
+        return;
+    }
+
+    node = &perf_nodes[perf_node_count++];
+    strlcpy(node->path, path, sizeof(node->path));
+    strlcpy(node->boost, value, sizeof(node->boost));
+    node->scaled = scaled;
+}
+
+/*
+ * Reads the boost profile. Each line is KEY=VALUE:
+ *   MAX_HOLD_MS=<ms>                  drop boosts held longer than this
+ *   MIN_FREQ=<cpu>,<kHz>              raise scaling_min_freq of cpu's policy
+ *   CPU_ONLINE=<cpu>                  keep cpu online
+ *   GOVERNOR=<cpu>,<tunable>,<value>  set an interactive governor tunable
+ */
+static void load_profile(void)
+{
+    char line[PATH_MAX], path[PATH_MAX];
+    FILE *file;
+
+    file = fopen(PERF_PROFILE_FILE, "re");
+    if (file == NULL) {
+        ALOGW("%s: no %s, perf locks will not boost", __func__, PERF_PROFILE_FILE);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *value = strchr(line, '=');
+        char *end, *tunable;
+        int cpu;
+
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '#' || value == NULL)
+            continue;
+        *value++ = '\0';
+
+        if (!strcmp(line, "MAX_HOLD_MS")) {
+            perf_max_hold_ns = strtoll(value, NULL, 10) * 1000000LL;
+            continue;
+        }
+
+        cpu = strtol(value, &end, 10);
+        if (end == value || cpu < 0) {
+            ALOGE("%s: bad entry %s=%s", __func__, line, value);
+            continue;
+        }
+
+        if (!strcmp(line, "MIN_FREQ") && *end == ',') {
+            snprintf(path, sizeof(path), CPU_SYSFS_DIR "/cpu%d/cpufreq/scaling_min_freq", cpu);
+            add_node(path, end + 1, 1);
+        } else if (!strcmp(line, "CPU_ONLINE") && *end == '\0') {
+            snprintf(path, sizeof(path), CPU_SYSFS_DIR "/cpu%d/online", cpu);
+            add_node(path, "1", 0);
+        } else if (!strcmp(line, "GOVERNOR") && *end == ',' &&
+                (value = strchr(end + 1, ',')) != NULL) {
+            tunable = end + 1;
+            *value++ = '\0';
+            snprintf(path, sizeof(path), CPU_SYSFS_DIR "/cpu%d/cpufreq/interactive/%s",
+                    cpu, tunable);
+            add_node(path, value, 0);
+        } else {
+            ALOGE("%s: bad entry %s=%s", __func__, line, value);
+        }
+    }
+
+    fclose(file);
+}
+
+static void perf_init(void)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&perf_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    load_profile();
+}
+
+/*
+ * Writes the boost values, remembering what they replace. A node that
+ * already holds the boost, e.g. because another process using this shim
+ * boosts it, is left alone and so is not restored by us either.
+ */
+static void apply_boost(int headroom)
+{
+    char value[PERF_VALUE_LEN];
+    int i;
+
+    for (i = 0; i < perf_node_count; i++) {
+        struct perf_node *node = &perf_nodes[i];
+        const char *boost = node->boost;
+
+        node->applied = 0;
+        if (read_node(node->path, node->saved, sizeof(node->saved)) != 0)
+            continue;
+
+        if (node->scaled) {
+            long long floor = strtoll(node->saved, NULL, 10);
+            long long target = strtoll(node->boost, NULL, 10);
+
+            if (headroom <= 0 || target <= floor)
+                continue;
+            if (headroom < 100) {
+                snprintf(value, sizeof(value), "%lld",
+                        floor + (target - floor) * headroom / 100);
+                boost = value;
+            }
+        } else if (!strcmp(node->saved, boost)) {
+            continue;
+        }
+
+        if (write_node(node, boost) == 0) {
+            if (read_node(node->path, node->written, sizeof(node->written)) != 0)
+                strlcpy(node->written, boost, sizeof(node->written));
+            node->written_floor = strtoll(boost, NULL, 10);
+            node->applied = 1;
+        }
+    }
+}
+
+/*
+ * Whether a node still holds our boost. A frequency floor the cpufreq
+ * notifiers, e.g. msm_thermal, have clamped below what we asked for is
+ * still ours; only a higher floor shows that someone else has set it.
+ */
+static int node_still_boosted(const struct perf_node *node, const char *value)
+{
+    if (!strcmp(value, node->written))
+        return 1;
+    return node->scaled && strtoll(value, NULL, 10) <= node->written_floor;
+}
+
+/*
+ * Restores in reverse so cores come back before their floors drop. Nodes
+ * that have been set since, by another perf lock user, the power HAL or
+ * init, keep their new value.
+ */
+static void restore_boost(void)
+{
+    char value[PERF_VALUE_LEN];
+    int i;
+
+    for (i = perf_node_count - 1; i >= 0; i--) {
+        struct perf_node *node = &perf_nodes[i];
+
+        if (node->applied && read_node(node->path, value, sizeof(value)) == 0 &&
+                node_still_boosted(node, value))
+            write_node(node, node->saved);
+        node->applied = 0;
+    }
+}
+
+static void record_hold(int64_t now, int expired)
+{
+    int64_t held_ms = (now - perf_boost_start_ns) / 1000000LL;
+    size_t bucket = 0;
+
+    while (bucket < PERF_HOLD_BUCKETS - 1 && held_ms >= hold_buckets_ms[bucket])
+        bucket++;
+
+    perf_stats.sessions++;
+    perf_stats.expired += expired;
+    perf_stats.total_ms += held_ms;
+    if (held_ms > perf_stats.max_ms)
+        perf_stats.max_ms = held_ms;
+    perf_stats.buckets[bucket]++;
+
+    ALOGD("%s: boost held %lld ms, peak %d locks%s", __func__, (long long)held_ms,
+            perf_peak_refs, expired ? ", expired" : "");
+
+    if (perf_stats.sessions % PERF_STATS_INTERVAL == 0)
+        ALOGI("%s: %u boosts, %u expired, mean %lld ms, max %lld ms, "
+                "<50ms %u <200ms %u <1s %u <5s %u longer %u", __func__,
+                perf_stats.sessions, perf_stats.expired,
+                (long long)(perf_stats.total_ms / perf_stats.sessions),
+                (long long)perf_stats.max_ms, perf_stats.buckets[0], perf_stats.buckets[1],
+                perf_stats.buckets[2], perf_stats.buckets[3], perf_stats.buckets[4]);
+}
+
+static void end_boost(int64_t now, int expired)
+{
+    restore_boost();
+    record_hold(now, expired);
+    perf_refs = 0;
+    perf_peak_refs = 0;
+}
+
+/*
+ * Drops perf locks whose holders never released them: the oldest held
+ * lock is released once it has been held for perf_max_hold_ns, and the
+ * boost with it if it was the last one.
+ */
+static void *perf_watchdog(void *arg)
+{
+    pthread_mutex_lock(&perf_lock);
+    for (;;) {
+        struct timespec deadline;
+        int64_t expiry;
+        int tracked;
+
+        while (perf_refs == 0)
+            pthread_cond_wait(&perf_cond, &perf_lock);
+
+        expiry = perf_acquire_ns[0] + perf_max_hold_ns;
+        if (now_ns() >= expiry) {
+            ALOGW("%s: perf lock held for over %lld ms, releasing it", __func__,
+                    (long long)(perf_max_hold_ns / 1000000LL));
+            tracked = perf_refs < PERF_MAX_LOCKS ? perf_refs : PERF_MAX_LOCKS;
+            memmove(&perf_acquire_ns[0], &perf_acquire_ns[1],
+                    (tracked - 1) * sizeof(perf_acquire_ns[0]));
+            if (--perf_refs == 0)
+                end_boost(now_ns(), 1);
+            continue;
+        }
+
+        deadline.tv_sec = expiry / 1000000000LL;
+        deadline.tv_nsec = expiry % 1000000000LL;
+        pthread_cond_timedwait(&perf_cond, &perf_lock, &deadline);
+    }
+    return NULL;
+}
+
+static void start_watchdog(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (perf_watchdog_running || perf_max_hold_ns <= 0)
+        return;
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, perf_watchdog, NULL) == 0) {
+        pthread_setname_np(thread, "perf_lock_wd");
+        perf_watchdog_running = 1;
+    } else {
+        ALOGE("%s: failed to start, leaked perf locks will not expire", __func__);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+/*
+ * Perf locks are reference counted: the first acquire applies the boost
+ * profile scaled by thermal headroom, the last release restores the
+ * previous values.
+ */
 int acquire_cpu_perf_lock(void)
 {
+    int headroom;
+    int64_t now;
+
+    pthread_once(&perf_once, perf_init);
+    // Lock-free on the thermal side, so it is read before taking perf_lock.
+    headroom = perf_node_count > 0 ? thermal_headroom() : 100;
+
+    pthread_mutex_lock(&perf_lock);
+    now = now_ns();
+    if (perf_refs == 0) {
+        if (headroom < 100)
+            ALOGD("%s: thermal headroom %d%%", __func__, headroom);
+        apply_boost(headroom);
+        perf_boost_start_ns = now;
+        start_watchdog();
+    }
+    perf_acquire_ns[perf_refs < PERF_MAX_LOCKS ? perf_refs : PERF_MAX_LOCKS - 1] = now;
+    if (++perf_refs > perf_peak_refs)
+        perf_peak_refs = perf_refs;
+    pthread_cond_signal(&perf_cond);
+    pthread_mutex_unlock(&perf_lock);
     return 0;
 }
 
 int release_cpu_perf_lock(void)
 {
-     return 0;
+    pthread_once(&perf_once, perf_init);
+
+    pthread_mutex_lock(&perf_lock);
+    if (perf_refs == 0) {
+        // Already expired, or released more often than acquired.
+        pthread_mutex_unlock(&perf_lock);
+        ALOGW("%s: no perf lock held", __func__);
+        return 0;
+    }
+    if (--perf_refs == 0) {
+        end_boost(now_ns(), 0);
+        pthread_cond_signal(&perf_cond);
+    }
+    pthread_mutex_unlock(&perf_lock);
+    return 0;
 }
@@ -17,16 +17,24 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #define LOG_TAG "ThermalHAL"
 #include <utils/Log.h>
 
+#include <cutils/properties.h>
 #include <hardware/hardware.h>
 #include <hardware/thermal.h>
 
+#include "thermal_trend.h"
+
 #define MAX_LENGTH                    50
 
 #define CPU_USAGE_FILE                "/proc/stat"
@@ -42,6 +50,8 @@ const int CPU_SENSORS[] = {4, 6, 9, 11};
 #define CPU_NUM                       (sizeof(CPU_SENSORS) / sizeof(int))
 // Sum of CPU_NUM + 3 for GPU, BATTERY, and SKIN.
 #define TEMPERATURE_NUM               7
+// Highest cpu%d that may show up in /proc/stat, plus one.
+#define MAX_CPUS                      8
 
 //qcom, therm-reset-temp
 #define CPU_SHUTDOWN_THRESHOLD        115
@@ -59,210 +69,635 @@ const int CPU_SENSORS[] = {4, 6, 9, 11};
 
 const char *CPU_LABEL[] = {"CPU0", "CPU1", "CPU2", "CPU3"};
 
+// Period of the background sampler; 0 samples on each HAL call instead.
+#define SAMPLE_PERIOD_PROPERTY        "ro.thermal.sample_period_ms"
+// /proc/stat lists the cpu lines first; the rest is not needed.
+#define CPU_USAGE_READ_SIZE           4096
+// Attempts to read a consistent snapshot before sampling directly.
+#define SNAPSHOT_READ_RETRIES         8
+// Sampler period started by trend queries when the property is not set.
+#define TREND_SAMPLE_PERIOD_MS        1000
+// A sampler started by trend queries stops after this long without one.
+#define TREND_IDLE_TIMEOUT_MS         60000
+// Readings per sensor the slope is fitted over.
+#define TREND_WINDOW                  16
+// Readings needed before a slope is reported.
+#define TREND_MIN_SAMPLES             3
+// Slower rises (Celsius per second) are treated as flat.
+#define TREND_MIN_SLOPE               0.01f
+
+struct temperature_sensor {
+    int sensor_num;
+    int type;
+    const char *name;
+    float mult;
+    float throttling_threshold;
+    float shutdown_threshold;
+    float vr_throttling_threshold;
+    int fd;
+};
+
+// In the order get_temperatures() reports them.
+static struct temperature_sensor g_sensors[TEMPERATURE_NUM] = {
+    // tsens_tz_sensor[4,6,9,11]: temperature in decidegrees Celsius.
+    { 4, DEVICE_TEMPERATURE_CPU, "CPU0", 0.1, CPU_THROTTLING_THRESHOLD,
+            CPU_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE, -1 },
+    { 6, DEVICE_TEMPERATURE_CPU, "CPU1", 0.1, CPU_THROTTLING_THRESHOLD,
+            CPU_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE, -1 },
+    { 9, DEVICE_TEMPERATURE_CPU, "CPU2", 0.1, CPU_THROTTLING_THRESHOLD,
+            CPU_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE, -1 },
+    { 11, DEVICE_TEMPERATURE_CPU, "CPU3", 0.1, CPU_THROTTLING_THRESHOLD,
+            CPU_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE, -1 },
+    // tsens_tz_sensor14: temperature in decidegrees Celsius.
+    { GPU_SENSOR_NUM, DEVICE_TEMPERATURE_GPU, GPU_LABEL, 0.1,
+            UNKNOWN_TEMPERATURE, UNKNOWN_TEMPERATURE, UNKNOWN_TEMPERATURE, -1 },
+    // tsens_tz_sensor29: battery: temperature in millidegrees Celsius.
+    { BATTERY_SENSOR_NUM, DEVICE_TEMPERATURE_BATTERY, BATTERY_LABEL, 0.001,
+            UNKNOWN_TEMPERATURE, BATTERY_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE, -1 },
+    // tsens_tz_sensor24: temperature in Celsius.
+    { SKIN_SENSOR_NUM, DEVICE_TEMPERATURE_SKIN, SKIN_LABEL, 1.,
+            SKIN_THROTTLING_THRESHOLD, SKIN_SHUTDOWN_THRESHOLD, VR_THROTTLED_BELOW_MIN, -1 },
+};
+
+static int g_cpu_usage_fd = -1;
+static int g_cpu_online_fd[MAX_CPUS] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+
+/*
+ * Everything both HAL calls report, as read at one point in time. The
+ * sampler thread publishes it under a sequence counter: odd while it is
+ * being written, so readers retry instead of taking a lock.
+ */
+struct thermal_sample {
+    int64_t time_ns;
+    ssize_t temperature_result;
+    int temperatures[TEMPERATURE_NUM];
+    ssize_t cpu_result;
+    uint64_t active[CPU_NUM];
+    uint64_t total[CPU_NUM];
+    int online[CPU_NUM];
+    // Filled by the sampler thread only.
+    float slope[TEMPERATURE_NUM];
+    float time_to_threshold[TEMPERATURE_NUM];
+};
+
+/* Recent readings of one sensor, oldest first from head. */
+struct temperature_history {
+    int64_t time_ns[TREND_WINDOW];
+    float value[TREND_WINDOW];
+    size_t head;
+    size_t count;
+};
+
+static struct {
+    volatile uint32_t seq;
+    struct thermal_sample sample;
+} g_snapshot;
+
+// Only touched by the sampler thread.
+static struct temperature_history g_history[TEMPERATURE_NUM];
+
+static pthread_once_t g_init_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_open_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static int64_t g_sample_period_ns;
+// Set when the property asked for the sampler, which then never stops.
+static bool g_sampler_always_on;
+static int64_t g_last_trend_query_ns;
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
 /**
- * Reads device temperature.
+ * Reads a sysfs or proc file from the start into buf through a cached fd.
+ * The fd is opened on first use and kept; it is never closed, so threads
+ * can share it with pread().
  *
- * @param sensor_num Number of sensor file with temperature.
- * @param type Device temperature type.
- * @param name Device temperature name.
- * @param mult Multiplier used to translate temperature to Celsius.
- * @param throttling_threshold Throttling threshold for the temperature.
- * @param shutdown_threshold Shutdown threshold for the temperature.
- * @param out Pointer to temperature_t structure that will be filled with current
- *     values.
+ * @param fd Cached fd, -1 until the file has been opened.
+ * @param format Path of the file, formatted with num only when needed.
+ * @param num Number substituted into format.
+ * @param buf Buffer that receives the NUL-terminated contents.
+ * @param size Size of buf.
  *
- * @return 0 on success or negative value -errno on error.
+ * @return Number of bytes read, or negative value -errno on error.
  */
-static ssize_t read_temperature(int sensor_num, int type, const char *name, float mult,
-        float throttling_threshold, float shutdown_threshold, float vr_throttling_threshold,
-        temperature_t *out) {
-    FILE *file;
+static ssize_t read_file(int *fd, const char *format, int num, char *buf, size_t size) {
     char file_name[MAX_LENGTH];
-    float temp;
+    int f = __atomic_load_n(fd, __ATOMIC_ACQUIRE);
+    ssize_t len;
+
+    if (f < 0) {
+        snprintf(file_name, sizeof(file_name), format, num);
+        pthread_mutex_lock(&g_open_lock);
+        f = *fd;
+        if (f < 0) {
+            f = open(file_name, O_RDONLY | O_CLOEXEC);
+            if (f < 0) {
+                int err = errno;
+                pthread_mutex_unlock(&g_open_lock);
+                ALOGE("%s: failed to open %s: %s", __func__, file_name, strerror(err));
+                return -err;
+            }
+            __atomic_store_n(fd, f, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&g_open_lock);
+    }
+
+    len = pread(f, buf, size - 1, 0);
+    if (len < 0) {
+        int err = errno;
+        snprintf(file_name, sizeof(file_name), format, num);
+        ALOGE("%s: failed to read %s: %s", __func__, file_name, strerror(err));
+        return -err;
+    }
+    buf[len] = '\0';
+    return len;
+}
 
-    sprintf(file_name, TEMPERATURE_FILE_FORMAT, sensor_num);
-    file = fopen(file_name, "r");
-    if (file == NULL) {
-        ALOGE("%s: failed to open: %s", __func__, strerror(errno));
-        return -errno;
+static const char *skip_blanks(const char *p) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
     }
-    if (1 != fscanf(file, "%f", &temp)) {
-        fclose(file);
-        ALOGE("%s: failed to read a float: %s", __func__, strerror(errno));
-        return errno ? -errno : -EIO;
+    return p;
+}
+
+/* Parses an unsigned decimal number; returns NULL if there is none. */
+static const char *parse_u64(const char *p, uint64_t *out) {
+    uint64_t v = 0;
+
+    p = skip_blanks(p);
+    if (!isdigit((unsigned char)*p)) {
+        return NULL;
     }
+    while (isdigit((unsigned char)*p)) {
+        v = v * 10 + (*p++ - '0');
+    }
+    *out = v;
+    return p;
+}
 
-    fclose(file);
+static const char *parse_int(const char *p, int *out) {
+    uint64_t v;
+    int negative;
 
+    p = skip_blanks(p);
+    negative = (*p == '-');
+    if (negative) {
+        p++;
+    }
+    p = parse_u64(p, &v);
+    if (p != NULL) {
+        *out = negative ? -(int)v : (int)v;
+    }
+    return p;
+}
+
+/**
+ * Reads the raw value of a temperature sensor.
+ *
+ * @param sensor Sensor to read.
+ * @param out Raw reading; multiply by the sensor's mult for Celsius.
+ *
+ * @return 0 on success or negative value -errno on error.
+ */
+static ssize_t read_temperature(struct temperature_sensor *sensor, int *out) {
+    char buf[16];
+    ssize_t len;
+
+    len = read_file(&sensor->fd, TEMPERATURE_FILE_FORMAT, sensor->sensor_num, buf, sizeof(buf));
+    if (len < 0) {
+        return len;
+    }
+    if (parse_int(buf, out) == NULL) {
+        ALOGE("%s: failed to read a number from sensor %d", __func__, sensor->sensor_num);
+        return -EIO;
+    }
+    return 0;
+}
+
+static void fill_temperature(const struct temperature_sensor *sensor, int raw,
+        temperature_t *out) {
     (*out) = (temperature_t) {
-        .type = type,
-        .name = name,
-        .current_value = temp * mult,
-        .throttling_threshold = throttling_threshold,
-        .shutdown_threshold = shutdown_threshold,
-        .vr_throttling_threshold = vr_throttling_threshold
+        .type = sensor->type,
+        .name = sensor->name,
+        .current_value = raw * sensor->mult,
+        .throttling_threshold = sensor->throttling_threshold,
+        .shutdown_threshold = sensor->shutdown_threshold,
+        .vr_throttling_threshold = sensor->vr_throttling_threshold
     };
+}
+
+/* Reads the first count sensors; stops at the first error. */
+static ssize_t sample_temperatures(int *temperatures, size_t count) {
+    size_t i;
 
+    for (i = 0; i < count; i++) {
+        ssize_t result = read_temperature(&g_sensors[i], &temperatures[i]);
+        if (result != 0) {
+            return result;
+        }
+    }
     return 0;
 }
 
-static ssize_t get_cpu_temperatures(temperature_t *list, size_t size) {
-    size_t cpu;
+static ssize_t read_cpu_online(int cpu_num, int *online) {
+    char buf[8];
+    ssize_t len;
 
-    for (cpu = 0; cpu < CPU_NUM; cpu++) {
-        if (cpu >= size) {
+    if (cpu_num < 0 || cpu_num >= MAX_CPUS) {
+        ALOGE("/proc/stat file has incorrect format.");
+        return -EIO;
+    }
+
+    len = read_file(&g_cpu_online_fd[cpu_num], CPU_ONLINE_FILE_FORMAT, cpu_num, buf, sizeof(buf));
+    if (len < 0) {
+        return len;
+    }
+    if (parse_int(buf, online) == NULL) {
+        ALOGE("%s: failed to read CPU online information from cpu%d", __func__, cpu_num);
+        return -EIO;
+    }
+    return 0;
+}
+
+static ssize_t sample_cpu_usages(uint64_t *active, uint64_t *total, int *online) {
+    char buf[CPU_USAGE_READ_SIZE];
+    const char *line, *p;
+    uint64_t user, nice, system, idle;
+    size_t size = 0;
+    ssize_t len;
+    int cpu_num;
+
+    len = read_file(&g_cpu_usage_fd, CPU_USAGE_FILE, 0, buf, sizeof(buf));
+    if (len < 0) {
+        return len;
+    }
+
+    for (line = buf; *line != '\0'; line = p + 1) {
+        p = strchr(line, '\n');
+        if (p == NULL) {
+            // Cut off by the read size, which only happens past the cpu lines.
             break;
         }
-        // tsens_tz_sensor[4,6,9,11]: temperature in decidegrees Celsius.
-        ssize_t result = read_temperature(CPU_SENSORS[cpu], DEVICE_TEMPERATURE_CPU, CPU_LABEL[cpu],
-                0.1, CPU_THROTTLING_THRESHOLD, CPU_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE,
-                &list[cpu]);
+
+        // Skip non "cpu[0-9]" lines.
+        if (strncmp(line, "cpu", 3) != 0 || !isdigit((unsigned char)line[3])) {
+            continue;
+        }
+
+        if (size == CPU_NUM) {
+            ALOGE("/proc/stat file has incorrect format.");
+            return -EIO;
+        }
+
+        const char *q = parse_int(line + 3, &cpu_num);
+        if (q != NULL) q = parse_u64(q, &user);
+        if (q != NULL) q = parse_u64(q, &nice);
+        if (q != NULL) q = parse_u64(q, &system);
+        if (q != NULL) q = parse_u64(q, &idle);
+        if (q == NULL) {
+            ALOGE("%s: failed to read CPU information from file", __func__);
+            return -EIO;
+        }
+
+        active[size] = user + nice + system;
+        total[size] = active[size] + idle;
+
+        // Read online CPU information.
+        ssize_t result = read_cpu_online(cpu_num, &online[size]);
         if (result != 0) {
             return result;
         }
+
+        size++;
     }
-    return cpu;
+
+    if (size != CPU_NUM) {
+        ALOGE("/proc/stat file has incorrect format.");
+        return -EIO;
+    }
+    return 0;
 }
 
-static ssize_t get_temperatures(thermal_module_t *module, temperature_t *list, size_t size) {
-    ssize_t result = 0;
-    size_t current_index = 0;
+static void sample_all(struct thermal_sample *sample) {
+    sample->temperature_result = sample_temperatures(sample->temperatures, TEMPERATURE_NUM);
+    sample->cpu_result = sample_cpu_usages(sample->active, sample->total, sample->online);
+    sample->time_ns = now_ns();
+}
 
-    if (list == NULL) {
-        return TEMPERATURE_NUM;
+static float trend_threshold(const struct temperature_sensor *sensor) {
+    if (sensor->throttling_threshold != UNKNOWN_TEMPERATURE) {
+        return sensor->throttling_threshold;
     }
+    return sensor->shutdown_threshold;
+}
 
-    result = get_cpu_temperatures(list, size);
-    if (result < 0) {
-        return result;
+/**
+ * Adds a reading to a sensor's history and fits a line through the window.
+ *
+ * @param history History of the sensor.
+ * @param time_ns Time of the reading.
+ * @param value Reading in Celsius.
+ *
+ * @return Least squares slope in Celsius per second, or 0 while the window
+ *     holds fewer than TREND_MIN_SAMPLES readings.
+ */
+static float update_slope(struct temperature_history *history, int64_t time_ns, float value) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, denominator;
+    size_t i, n;
+
+    i = (history->head + history->count) % TREND_WINDOW;
+    history->time_ns[i] = time_ns;
+    history->value[i] = value;
+    if (history->count < TREND_WINDOW) {
+        history->count++;
+    } else {
+        history->head = (history->head + 1) % TREND_WINDOW;
     }
-    current_index += result;
 
-    // GPU temperature.
-    if (current_index < size) {
-        // tsens_tz_sensor14: temperature in decidegrees Celsius.
-        result = read_temperature(GPU_SENSOR_NUM, DEVICE_TEMPERATURE_GPU, GPU_LABEL, 0.1,
-                UNKNOWN_TEMPERATURE, UNKNOWN_TEMPERATURE, UNKNOWN_TEMPERATURE,
-                &list[current_index]);
-        if (result < 0) {
-            return result;
-        }
-        current_index++;
+    n = history->count;
+    if (n < TREND_MIN_SAMPLES) {
+        return 0;
     }
 
-    // Battery temperature.
-    if (current_index < size) {
-        // tsens_tz_sensor29: battery: temperature in millidegrees Celsius.
-        result = read_temperature(BATTERY_SENSOR_NUM, DEVICE_TEMPERATURE_BATTERY, BATTERY_LABEL,
-                0.001, UNKNOWN_TEMPERATURE, BATTERY_SHUTDOWN_THRESHOLD, UNKNOWN_TEMPERATURE,
-                &list[current_index]);
-        if (result < 0) {
-            return result;
-        }
-        current_index++;
+    for (i = 0; i < n; i++) {
+        size_t j = (history->head + i) % TREND_WINDOW;
+        // Seconds relative to the newest reading keeps the sums small.
+        double x = (history->time_ns[j] - time_ns) / 1e9;
+        double y = history->value[j];
+        sx += x;
+        sy += y;
+        sxx += x * x;
+        sxy += x * y;
     }
 
-    // Skin temperature.
-    if (current_index < size) {
-        // tsens_tz_sensor24: temperature in Celsius.
-        result = read_temperature(SKIN_SENSOR_NUM, DEVICE_TEMPERATURE_SKIN, SKIN_LABEL, 1.,
-                SKIN_THROTTLING_THRESHOLD, SKIN_SHUTDOWN_THRESHOLD, VR_THROTTLED_BELOW_MIN,
-                &list[current_index]);
-        if (result < 0) {
-            return result;
-        }
-        current_index++;
+    denominator = n * sxx - sx * sx;
+    if (denominator <= 0) {
+        return 0;
     }
-    return TEMPERATURE_NUM;
+    return (float)((n * sxy - sx * sy) / denominator);
 }
 
-static ssize_t get_cpu_usages(thermal_module_t *module, cpu_usage_t *list) {
-    int vals, cpu_num, online;
-    ssize_t read;
-    uint64_t user, nice, system, idle, active, total;
-    char *line = NULL;
-    size_t len = 0;
-    size_t size = 0;
-    char file_name[MAX_LENGTH];
-    FILE *file;
-    FILE *cpu_file;
+/* Seconds until value reaches threshold at slope, 0 if it has, -1 if never. */
+static float time_to_threshold(float value, float threshold, float slope) {
+    if (threshold == UNKNOWN_TEMPERATURE) {
+        return -1;
+    } else if (value >= threshold) {
+        return 0;
+    } else if (slope < TREND_MIN_SLOPE) {
+        return -1;
+    }
+    return (threshold - value) / slope;
+}
 
-    if (list == NULL) {
-        return CPU_NUM;
+static void update_trends(struct thermal_sample *sample) {
+    size_t i;
+
+    for (i = 0; i < TEMPERATURE_NUM; i++) {
+        const struct temperature_sensor *sensor = &g_sensors[i];
+        float value;
+
+        if (sample->temperature_result != 0) {
+            // Keep the previous trend rather than fit a partial sample.
+            sample->slope[i] = g_snapshot.sample.slope[i];
+            sample->time_to_threshold[i] = g_snapshot.sample.time_to_threshold[i];
+            continue;
+        }
+
+        value = sample->temperatures[i] * sensor->mult;
+        sample->slope[i] = update_slope(&g_history[i], sample->time_ns, value);
+        sample->time_to_threshold[i] = time_to_threshold(value,
+                trend_threshold(sensor), sample->slope[i]);
     }
+}
+
+static void publish_sample(const struct thermal_sample *sample) {
+    g_snapshot.seq++;
+    __sync_synchronize();
+    g_snapshot.sample = *sample;
+    __sync_synchronize();
+    g_snapshot.seq++;
+}
+
+/**
+ * Copies the sampler's latest snapshot into out.
+ *
+ * @return 1 if a snapshot younger than two sample periods was copied, else 0.
+ */
+static int read_snapshot(struct thermal_sample *out) {
+    int tries;
 
-    file = fopen(CPU_USAGE_FILE, "r");
-    if (file == NULL) {
-        ALOGE("%s: failed to open: %s", __func__, strerror(errno));
-        return -errno;
+    int64_t period = __atomic_load_n(&g_sample_period_ns, __ATOMIC_ACQUIRE);
+
+    if (period == 0) {
+        return 0;
     }
 
-    while ((read = getline(&line, &len, file)) != -1) {
-        // Skip non "cpu[0-9]" lines.
-        if (strnlen(line, read) < 4 || strncmp(line, "cpu", 3) != 0 || !isdigit(line[3])) {
-            free(line);
-            line = NULL;
-            len = 0;
+    for (tries = 0; tries < SNAPSHOT_READ_RETRIES; tries++) {
+        uint32_t seq = g_snapshot.seq;
+        if (seq & 1) {
             continue;
         }
+        __sync_synchronize();
+        *out = g_snapshot.sample;
+        __sync_synchronize();
+        if (g_snapshot.seq == seq) {
+            return seq != 0 && now_ns() - out->time_ns < 2 * period;
+        }
+    }
+    return 0;
+}
 
-        vals = sscanf(line, "cpu%d %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64, &cpu_num, &user,
-                &nice, &system, &idle);
+/*
+ * Stops the sampler once trends have not been asked for in a while. Runs
+ * on the sampler thread; it exits if this returns true.
+ */
+static bool stop_idle_sampler(void) {
+    int64_t last = __atomic_load_n(&g_last_trend_query_ns, __ATOMIC_SEQ_CST);
+    bool stop;
 
-        free(line);
-        line = NULL;
-        len = 0;
+    if (g_sampler_always_on || now_ns() - last < TREND_IDLE_TIMEOUT_MS * 1000000LL) {
+        return false;
+    }
 
-        if (vals != 5 || size == CPU_NUM) {
-            if (vals != 5) {
-                ALOGE("%s: failed to read CPU information from file: %s", __func__,
-                        strerror(errno));
-            } else {
-                ALOGE("/proc/stat file has incorrect format.");
-            }
-            fclose(file);
-            return errno ? -errno : -EIO;
-        }
+    pthread_mutex_lock(&g_sampler_lock);
+    // A query may have come in meanwhile, and found the sampler running.
+    last = __atomic_load_n(&g_last_trend_query_ns, __ATOMIC_SEQ_CST);
+    stop = now_ns() - last >= TREND_IDLE_TIMEOUT_MS * 1000000LL;
+    if (stop) {
+        __atomic_store_n(&g_sample_period_ns, 0, __ATOMIC_SEQ_CST);
+        // A restarted sampler must not fit a slope across the gap.
+        memset(g_history, 0, sizeof(g_history));
+    }
+    pthread_mutex_unlock(&g_sampler_lock);
 
-        active = user + nice + system;
-        total = active + idle;
+    return stop;
+}
 
-        // Read online CPU information.
-        snprintf(file_name, MAX_LENGTH, CPU_ONLINE_FILE_FORMAT, cpu_num);
-        cpu_file = fopen(file_name, "r");
-        online = 0;
-        if (cpu_file == NULL) {
-            ALOGE("%s: failed to open file: %s (%s)", __func__, file_name, strerror(errno));
-            fclose(file);
-            return -errno;
+static void *sampler_thread(void *arg) {
+    struct thermal_sample sample;
+    struct timespec next;
+    int64_t period = g_sample_period_ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop_idle_sampler()) {
+        sample_all(&sample);
+        update_trends(&sample);
+        publish_sample(&sample);
+
+        next.tv_sec += period / 1000000000LL;
+        next.tv_nsec += period % 1000000000LL;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
         }
-        if (1 != fscanf(cpu_file, "%d", &online)) {
-            ALOGE("%s: failed to read CPU online information from file: %s (%s)", __func__,
-                    file_name, strerror(errno));
-            fclose(file);
-            fclose(cpu_file);
-            return errno ? -errno : -EIO;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) {
         }
-        fclose(cpu_file);
+    }
+    return NULL;
+}
 
-        list[size] = (cpu_usage_t) {
-            .name = CPU_LABEL[size],
-            .active = active,
-            .total = total,
-            .is_online = online
-        };
+/* Starts the sampler thread unless it is already running. */
+static void start_sampler(int period_ms) {
+    pthread_attr_t attr;
+    pthread_t thread;
 
-        size++;
+    if (__atomic_load_n(&g_sample_period_ns, __ATOMIC_SEQ_CST) != 0) {
+        return;
     }
-    fclose(file);
 
-    if (size != CPU_NUM) {
-        ALOGE("/proc/stat file has incorrect format.");
-        return -EIO;
+    pthread_mutex_lock(&g_sampler_lock);
+    if (g_sample_period_ns != 0) {
+        pthread_mutex_unlock(&g_sampler_lock);
+        return;
+    }
+
+    __atomic_store_n(&g_sample_period_ns, (int64_t)period_ms * 1000000LL, __ATOMIC_RELEASE);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, sampler_thread, NULL) != 0) {
+        ALOGE("%s: failed to start the sampler, sampling on demand", __func__);
+        __atomic_store_n(&g_sample_period_ns, 0, __ATOMIC_RELEASE);
+    } else {
+        pthread_setname_np(thread, "thermal_sampler");
+    }
+    pthread_attr_destroy(&attr);
+    pthread_mutex_unlock(&g_sampler_lock);
+}
+
+static void init_sampler(void) {
+    int period_ms = property_get_int32(SAMPLE_PERIOD_PROPERTY, 0);
+
+    if (period_ms > 0) {
+        g_sampler_always_on = true;
+        start_sampler(period_ms);
+    }
+}
+
+static ssize_t get_temperatures(thermal_module_t *module, temperature_t *list, size_t size) {
+    struct thermal_sample sample;
+    ssize_t result;
+    size_t i, count;
+
+    if (list == NULL) {
+        return TEMPERATURE_NUM;
+    }
+
+    pthread_once(&g_init_once, init_sampler);
+
+    count = size < TEMPERATURE_NUM ? size : TEMPERATURE_NUM;
+    if (read_snapshot(&sample)) {
+        result = sample.temperature_result;
+    } else {
+        result = sample_temperatures(sample.temperatures, count);
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    for (i = 0; i < count; i++) {
+        fill_temperature(&g_sensors[i], sample.temperatures[i], &list[i]);
+    }
+    return TEMPERATURE_NUM;
+}
+
+static ssize_t get_cpu_usages(thermal_module_t *module, cpu_usage_t *list) {
+    struct thermal_sample sample;
+    ssize_t result;
+    size_t i;
+
+    if (list == NULL) {
+        return CPU_NUM;
+    }
+
+    pthread_once(&g_init_once, init_sampler);
+
+    if (read_snapshot(&sample)) {
+        result = sample.cpu_result;
+    } else {
+        result = sample_cpu_usages(sample.active, sample.total, sample.online);
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    for (i = 0; i < CPU_NUM; i++) {
+        list[i] = (cpu_usage_t) {
+            .name = CPU_LABEL[i],
+            .active = sample.active[i],
+            .total = sample.total[i],
+            .is_online = sample.online[i]
+        };
     }
     return CPU_NUM;
 }
 
+__attribute__((visibility("default")))
+ssize_t thermal_get_temperature_trends(temperature_trend_t *list, size_t size) {
+    struct thermal_sample sample;
+    size_t i;
+
+    if (list == NULL) {
+        return TEMPERATURE_NUM;
+    }
+
+    pthread_once(&g_init_once, init_sampler);
+    // Before start_sampler(), so an idle sampler about to stop sees it.
+    __atomic_store_n(&g_last_trend_query_ns, now_ns(), __ATOMIC_SEQ_CST);
+    start_sampler(TREND_SAMPLE_PERIOD_MS);
+
+    if (!read_snapshot(&sample)) {
+        // No slope yet, but a sensor already past its threshold must not
+        // wait for the sampler to be reported.
+        sample.temperature_result = sample_temperatures(sample.temperatures, TEMPERATURE_NUM);
+        for (i = 0; i < TEMPERATURE_NUM; i++) {
+            const struct temperature_sensor *sensor = &g_sensors[i];
+            sample.slope[i] = 0;
+            sample.time_to_threshold[i] = time_to_threshold(
+                    sample.temperatures[i] * sensor->mult, trend_threshold(sensor), 0);
+        }
+    }
+    if (sample.temperature_result < 0) {
+        return sample.temperature_result;
+    }
+
+    for (i = 0; i < size && i < TEMPERATURE_NUM; i++) {
+        const struct temperature_sensor *sensor = &g_sensors[i];
+        list[i] = (temperature_trend_t) {
+            .type = sensor->type,
+            .name = sensor->name,
+            .current_value = sample.temperatures[i] * sensor->mult,
+            .slope = sample.slope[i],
+            .threshold = trend_threshold(sensor),
+            .time_to_threshold = sample.time_to_threshold[i]
+        };
+    }
+    return TEMPERATURE_NUM;
+}
+
 static struct hw_module_methods_t thermal_module_methods = {
     .open = NULL,
 };
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2016 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef THERMAL_TREND_H
+#define THERMAL_TREND_H
+
+#include <sys/types.h>
+
+#include <hardware/thermal.h>
+
+__BEGIN_DECLS
+
+/*
+ * Extension of the thermal HAL that reports where each temperature is
+ * heading, so boost users can back off before a sensor crosses its
+ * threshold. It is not part of thermal_module_t; look it up with
+ * dlsym(module->common.dso, THERMAL_TREND_SYMBOL) after hw_get_module().
+ */
+
+#define THERMAL_TREND_SYMBOL "thermal_get_temperature_trends"
+
+typedef struct {
+    enum temperature_type type;
+    const char *name;
+    // Latest reading in Celsius.
+    float current_value;
+    // Rate of change in Celsius per second over the recent window.
+    float slope;
+    // Throttling threshold, or the shutdown threshold for sensors that
+    // only have one. UNKNOWN_TEMPERATURE if the sensor has neither.
+    float threshold;
+    // Seconds until threshold is reached at the current slope: 0 if it
+    // already is, negative if the sensor is not heading towards it.
+    float time_to_threshold;
+} temperature_trend_t;
+
+/**
+ * Fills list with the trend of each temperature, in the order
+ * getTemperatures() reports them. The first call starts the HAL's
+ * background sampler, so slopes become available after a few samples;
+ * until then they are 0 and the temperatures are read directly. The
+ * sampler stops again after a minute without a call, unless
+ * ro.thermal.sample_period_ms keeps it running.
+ *
+ * @param list Array of temperature_trend_t, or NULL to query the count.
+ * @param size Number of entries list can hold.
+ *
+ * @return Number of trends the HAL reports, or negative value -errno on
+ *     error.
+ */
+typedef ssize_t (*thermal_get_temperature_trends_t)(temperature_trend_t *list, size_t size);
+
+__END_DECLS
+
+#endif // THERMAL_TREND_H